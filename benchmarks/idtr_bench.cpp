@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Microbenchmarks of the idtr runtime: halo updates, reshapes, reductions,
+  (un)packing of strided data and the Transceiver collectives, driven
+  directly with synthetic arrays and without the JIT.
+
+  Build with -DSHARPY_BENCHMARKS=ON (requires Google Benchmark), run with
+    idtr_bench [--benchmark_filter=<regex>] [--benchmark_format=json]
+  or under MPI, e.g.
+    mpirun -n 4 idtr_bench
+  Only rank 0 reports. Benchmarks which communicate report the time of the
+  slowest rank (manual time), so all ranks run the same number of
+  iterations. Halo updates and reshapes do not communicate with one rank.
+
+  Arrays are partitioned along the first dimension, like sharpy does.
+*/
+
+#include <sharpy/CppTypes.hpp>
+#include <sharpy/MPITransceiver.hpp>
+#include <sharpy/MemRefType.hpp>
+#include <sharpy/Transceiver.hpp>
+
+#include <benchmark/benchmark.h>
+#include <imex/Dialect/NDArray/IR/NDArrayDefs.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// entry points of libidtr; jit-compiled code declares them itself
+struct WaitHandleBase;
+extern "C" {
+void _idtr_wait(WaitHandleBase *handle);
+void _idtr_reduce_all_f64(int64_t dataRank, void *dataDescr, int op);
+void _idtr_reduce_all_f32(int64_t dataRank, void *dataDescr, int op);
+void _idtr_reduce_all_i64(int64_t dataRank, void *dataDescr, int op);
+void _idtr_reduce_all_i32(int64_t dataRank, void *dataDescr, int op);
+}
+void bufferize(void *cptr, SHARPY::DTypeId dtype, const int64_t *sizes,
+               const int64_t *strides, const int64_t *tStarts,
+               const int64_t *tSizes, uint64_t nd, uint64_t N, void *out);
+void unpack(void *in, SHARPY::DTypeId dtype, const int64_t *sizes,
+            const int64_t *strides, const int64_t *tStarts,
+            const int64_t *tSizes, uint64_t nd, uint64_t N, void *out);
+void *_idtr_update_halo(SHARPY::DTypeId sharpytype, int64_t ndims,
+                        int64_t *ownedOff, int64_t *ownedShape,
+                        int64_t *ownedStride, int64_t *bbOff, int64_t *bbShape,
+                        void *ownedData, int64_t *leftHaloShape,
+                        int64_t *leftHaloStride, void *leftHaloData,
+                        int64_t *rightHaloShape, int64_t *rightHaloStride,
+                        void *rightHaloData, SHARPY::Transceiver *tc,
+                        int64_t key);
+WaitHandleBase *_idtr_copy_reshape(SHARPY::DTypeId sharpytype,
+                                   SHARPY::Transceiver *tc, int64_t iNDims,
+                                   int64_t *iGShapePtr, int64_t *iOffsPtr,
+                                   void *iDataPtr, int64_t *iDataShapePtr,
+                                   int64_t *iDataStridesPtr, int64_t oNDims,
+                                   int64_t *oGShapePtr, int64_t *oOffsPtr,
+                                   void *oDataPtr, int64_t *oDataShapePtr,
+                                   int64_t *oDataStridesPtr);
+
+using SHARPY::getTransceiver;
+using SHARPY::rank_type;
+
+namespace {
+
+using Shape = std::vector<int64_t>;
+
+Shape strides_of(const Shape &shape) {
+  Shape strides(shape.size(), 1);
+  for (auto i = shape.size(); i > 1; --i) {
+    strides[i - 2] = strides[i - 1] * shape[i - 1];
+  }
+  return strides;
+}
+
+int64_t numel(const Shape &shape) {
+  return std::accumulate(shape.begin(), shape.end(), int64_t(1),
+                         std::multiplies<int64_t>());
+}
+
+/// run f once per iteration and report the time of the slowest rank
+template <typename F> void run_timed(benchmark::State &state, F &&f) {
+  auto tc = getTransceiver();
+  for (auto _ : state) {
+    tc->barrier();
+    auto begin = std::chrono::steady_clock::now();
+    f();
+    double t = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             begin)
+                   .count();
+    tc->reduce_all(&t, SHARPY::FLOAT64, 1, SHARPY::MAX);
+    state.SetIterationTime(t);
+  }
+}
+
+// ***************************************************************************
+// bufferize/unpack a box in the middle of an array, as for halos of views
+
+template <typename T> void BM_Bufferize(benchmark::State &state) {
+  auto nd = state.range(0);
+  auto n = state.range(1); // extent of each dimension
+  Shape shape(nd, n), starts(nd, n / 4), sizes(nd, n / 2);
+  auto strides = strides_of(shape);
+  std::vector<T> in(numel(shape), T(1)), out(numel(sizes));
+  for (auto _ : state) {
+    bufferize(in.data(), SHARPY::DTYPE<T>::value, sizes.data(),
+              strides.data(), starts.data(), sizes.data(), nd, 1, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * out.size() * sizeof(T));
+}
+
+template <typename T> void BM_Unpack(benchmark::State &state) {
+  auto nd = state.range(0);
+  auto n = state.range(1);
+  Shape shape(nd, n), starts(nd, n / 4), sizes(nd, n / 2);
+  auto strides = strides_of(shape);
+  std::vector<T> in(numel(sizes), T(1)), out(numel(shape));
+  for (auto _ : state) {
+    unpack(in.data(), SHARPY::DTYPE<T>::value, sizes.data(), strides.data(),
+           starts.data(), sizes.data(), nd, 1, out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * in.size() * sizeof(T));
+}
+
+// ***************************************************************************
+// halo update of a stencil: every rank owns n rows of n^(nd-1) elements and
+// needs w rows of each neighbor
+
+template <typename T> void BM_UpdateHalo(benchmark::State &state) {
+  auto tc = getTransceiver();
+  auto nd = state.range(0);
+  auto n = state.range(1);
+  auto w = state.range(2);
+  auto me = static_cast<int64_t>(tc->rank());
+  auto nr = static_cast<int64_t>(tc->nranks());
+
+  Shape owned(nd, n), ownedOff(nd, 0), bbOff(nd, 0);
+  auto ownedStrides = strides_of(owned);
+  ownedOff[0] = me * n;
+  bbOff[0] = std::max<int64_t>(0, ownedOff[0] - w);
+  auto bbEnd = std::min(nr * n, ownedOff[0] + n + w);
+  auto bbShape = owned;
+  bbShape[0] = bbEnd - bbOff[0];
+  auto lHalo = owned, rHalo = owned;
+  lHalo[0] = ownedOff[0] - bbOff[0];
+  rHalo[0] = bbEnd - ownedOff[0] - n;
+  auto lStrides = strides_of(lHalo), rStrides = strides_of(rHalo);
+
+  std::vector<T> data(numel(owned), T(me));
+  // never empty, the runtime expects valid pointers
+  std::vector<T> lData(std::max<int64_t>(1, numel(lHalo)));
+  std::vector<T> rData(std::max<int64_t>(1, numel(rHalo)));
+  // meta data gets cached per configuration as with jit-compiled code
+  auto key = (nd * 1000003 + n) * 1009 + w * 16 + SHARPY::DTYPE<T>::value;
+
+  run_timed(state, [&]() {
+    auto h = _idtr_update_halo(
+        SHARPY::DTYPE<T>::value, nd, ownedOff.data(), owned.data(),
+        ownedStrides.data(), bbOff.data(), bbShape.data(), data.data(),
+        lHalo.data(), lStrides.data(), lData.data(), rHalo.data(),
+        rStrides.data(), rData.data(), tc, key);
+    _idtr_wait(static_cast<WaitHandleBase *>(h));
+  });
+  state.SetBytesProcessed(state.iterations() *
+                          (numel(lHalo) + numel(rHalo)) * sizeof(T));
+}
+
+// ***************************************************************************
+// reshape a 1d array of n elements per rank into rows of 16 elements;
+// the rows get partitioned with an offset, half of the data moves
+
+template <typename T> void BM_CopyReshape(benchmark::State &state) {
+  auto tc = getTransceiver();
+  auto n = state.range(0);
+  auto me = static_cast<int64_t>(tc->rank());
+  auto nr = static_cast<int64_t>(tc->nranks());
+  constexpr int64_t cols = 16;
+
+  Shape iGShape = {nr * n}, iOffs = {me * n}, iShape = {n};
+  auto iStrides = strides_of(iShape);
+  auto rows = nr * n / cols;
+  auto start = [rows, nr](int64_t r) {
+    return r == 0 ? 0 : std::min(rows, r * rows / nr + rows / (2 * nr));
+  };
+  Shape oGShape = {rows, cols}, oOffs = {start(me), 0};
+  Shape oShape = {start(me + 1) - start(me), cols};
+  auto oStrides = strides_of(oShape);
+  std::vector<T> in(n, T(me)), out(std::max<int64_t>(1, numel(oShape)));
+
+  run_timed(state, [&]() {
+    auto h = _idtr_copy_reshape(
+        SHARPY::DTYPE<T>::value, tc, 1, iGShape.data(), iOffs.data(),
+        in.data(), iShape.data(), iStrides.data(), 2, oGShape.data(),
+        oOffs.data(), out.data(), oShape.data(), oStrides.data());
+    _idtr_wait(h);
+  });
+  state.SetBytesProcessed(state.iterations() * n * sizeof(T));
+}
+
+// ***************************************************************************
+// reduction of n elements as called by jit-compiled code
+
+template <typename T> struct ReduceAll {};
+template <> struct ReduceAll<double> {
+  static constexpr auto f = _idtr_reduce_all_f64;
+};
+template <> struct ReduceAll<float> {
+  static constexpr auto f = _idtr_reduce_all_f32;
+};
+template <> struct ReduceAll<int64_t> {
+  static constexpr auto f = _idtr_reduce_all_i64;
+};
+template <> struct ReduceAll<int32_t> {
+  static constexpr auto f = _idtr_reduce_all_i32;
+};
+
+template <typename T> void BM_ReduceAll(benchmark::State &state) {
+  auto n = state.range(0);
+  std::vector<T> data(n, T(1));
+  SHARPY::MemRefDescriptor<T, 1> descr;
+  descr.allocated = descr.aligned = data.data();
+  descr.sizes[0] = n;
+  descr.strides[0] = 1;
+  run_timed(state, [&]() {
+    ReduceAll<T>::f(1, &descr, ::imex::ndarray::SUM);
+  });
+  state.SetBytesProcessed(state.iterations() * n * sizeof(T));
+}
+
+// ***************************************************************************
+// Transceiver collectives
+
+void BM_Barrier(benchmark::State &state) {
+  run_timed(state, []() { getTransceiver()->barrier(); });
+}
+
+void BM_Bcast(benchmark::State &state) {
+  std::vector<char> data(state.range(0));
+  run_timed(state, [&]() {
+    getTransceiver()->bcast(data.data(), data.size(), 0);
+  });
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+// every rank sends n elements to every other rank
+template <typename T> void BM_Alltoallv(benchmark::State &state) {
+  auto tc = getTransceiver();
+  auto nr = tc->nranks();
+  auto n = static_cast<int>(state.range(0));
+  std::vector<int> counts(nr, n), displs(nr);
+  for (rank_type i = 0; i < nr; ++i) {
+    displs[i] = i * n;
+  }
+  std::vector<T> send(nr * n, T(1)), recv(nr * n);
+  run_timed(state, [&]() {
+    tc->wait(tc->alltoall(send.data(), counts.data(), displs.data(),
+                          SHARPY::DTYPE<T>::value, recv.data(), counts.data(),
+                          displs.data()));
+  });
+  state.SetBytesProcessed(state.iterations() * send.size() * sizeof(T));
+}
+
+// every rank contributes n elements
+template <typename T> void BM_Allgatherv(benchmark::State &state) {
+  auto tc = getTransceiver();
+  auto nr = tc->nranks();
+  auto n = static_cast<int>(state.range(0));
+  std::vector<int> counts(nr, n), displs(nr);
+  for (rank_type i = 0; i < nr; ++i) {
+    displs[i] = i * n;
+  }
+  std::vector<T> data(nr * n, T(1));
+  run_timed(state, [&]() {
+    tc->gather(data.data(), counts.data(), displs.data(),
+               SHARPY::DTYPE<T>::value, SHARPY::REPLICATED);
+  });
+  state.SetBytesProcessed(state.iterations() * data.size() * sizeof(T));
+}
+
+// ***************************************************************************
+
+void pack_args(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"nd", "n"});
+  for (auto nd : {1, 2, 3}) {
+    // about 1K to 16M elements
+    for (auto e : {1 << 10, 1 << 16, 1 << 20, 1 << 24}) {
+      b->Args({nd, static_cast<int64_t>(std::pow(e, 1. / nd) + 0.5)});
+    }
+  }
+}
+
+void halo_args(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"nd", "n", "w"});
+  for (auto nd : {1, 2, 3}) {
+    for (int64_t e : {1 << 16, 1 << 20, 1 << 24}) {
+      auto n = static_cast<int64_t>(std::pow(e, 1. / nd) + 0.5);
+      for (int64_t w : {1, 2, 4}) {
+        b->Args({nd, n, w});
+      }
+    }
+  }
+  b->UseManualTime();
+}
+
+// n elements per rank
+void size_args(benchmark::internal::Benchmark *b) {
+  b->ArgName("n")->RangeMultiplier(16)->Range(1, 1 << 24)->UseManualTime();
+}
+
+// n elements per rank, full rows of 16
+void reshape_args(benchmark::internal::Benchmark *b) {
+  b->ArgName("n")->RangeMultiplier(16)->Range(1 << 8, 1 << 24)->UseManualTime();
+}
+
+// n elements per pair of ranks
+void comm_args(benchmark::internal::Benchmark *b) {
+  b->ArgName("n")->RangeMultiplier(16)->Range(1, 1 << 20)->UseManualTime();
+}
+
+} // namespace
+
+#define BENCHMARK_DTYPES(_f, _args)                                            \
+  BENCHMARK_TEMPLATE(_f, double)->Apply(_args);                                \
+  BENCHMARK_TEMPLATE(_f, float)->Apply(_args);                                 \
+  BENCHMARK_TEMPLATE(_f, int64_t)->Apply(_args);                               \
+  BENCHMARK_TEMPLATE(_f, int32_t)->Apply(_args)
+
+BENCHMARK_DTYPES(BM_Bufferize, pack_args);
+BENCHMARK_DTYPES(BM_Unpack, pack_args);
+BENCHMARK_DTYPES(BM_UpdateHalo, halo_args);
+BENCHMARK_DTYPES(BM_CopyReshape, reshape_args);
+BENCHMARK_DTYPES(BM_ReduceAll, size_args);
+BENCHMARK_DTYPES(BM_Alltoallv, comm_args);
+BENCHMARK_DTYPES(BM_Allgatherv, comm_args);
+BENCHMARK(BM_Barrier)->UseManualTime();
+BENCHMARK(BM_Bcast)->Apply(size_args);
+
+namespace {
+// reports nothing, for all ranks but 0
+class NullReporter : public benchmark::BenchmarkReporter {
+public:
+  bool ReportContext(const Context &) override { return true; }
+  void ReportRuns(const std::vector<Run> &) override {}
+};
+} // namespace
+
+int main(int argc, char **argv) {
+  SHARPY::init_transceiver(new SHARPY::MPITransceiver(false));
+  // a file reporter without --benchmark_out is an error
+  bool fileOut = std::any_of(argv + 1, argv + argc, [](const char *arg) {
+    return std::string(arg).rfind("--benchmark_out=", 0) == 0;
+  });
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    SHARPY::fini_transceiver();
+    return 1;
+  }
+  if (getTransceiver()->rank() == 0) {
+    benchmark::RunSpecifiedBenchmarks();
+  } else {
+    // also replaces the file reporter of --benchmark_out
+    NullReporter null;
+    benchmark::RunSpecifiedBenchmarks(&null, fileOut ? &null : nullptr);
+  }
+  benchmark::Shutdown();
+  SHARPY::fini_transceiver();
+  return 0;
+}
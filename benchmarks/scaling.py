@@ -0,0 +1,334 @@
+"""
+Scaling benchmarks of the examples.
+
+Runs the examples over a matrix of problem sizes and rank counts and
+collects their timing (see examples/timing.py) into one JSON file: time of
+the first iteration (including jit compilation), steady-state time per
+iteration, throughput and parallel efficiency.
+
+Usage:
+
+    # strong scaling: fixed global problem size
+    python benchmarks/scaling.py run -r 1 2 4 -o base.json
+
+    # weak scaling: problem size grows with the number of ranks
+    python benchmarks/scaling.py run -m weak -k stencil-2d -s 2048 -o new.json
+
+    # compare two runs, e.g. of different commits; fails on regressions
+    python benchmarks/scaling.py compare base.json new.json
+
+In weak scaling mode sizes are given for a single rank. Runs with more than
+one rank are launched with --launcher, e.g. "mpiexec -n {ranks}".
+
+To add a kernel, add an example which reports with timing.Timer and an
+entry to KERNELS.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import shlex
+import subprocess
+import sys
+import tempfile
+
+EXAMPLES = os.path.join(
+    os.path.dirname(os.path.abspath(__file__)), "..", "examples"
+)
+
+
+class Kernel:
+    """
+    An example to benchmark.
+    args(size, datatype, iterations) returns its command line arguments.
+    dims is the number of dimensions size applies to, e.g. for weak scaling.
+    """
+
+    def __init__(self, script, args, dims, sizes):
+        self.script = script
+        self.args = args
+        self.dims = dims
+        self.sizes = sizes
+
+
+KERNELS = {
+    # always float32
+    "stencil-2d": Kernel(
+        "stencil-2d.py",
+        lambda n, dt, it: [str(it), str(n), "star", "2"],
+        2,
+        [1024, 4096],
+    ),
+    "wave_equation": Kernel(
+        "wave_equation.py",
+        lambda n, dt, it: ["-n", str(n), "-t", "-d", dt],
+        2,
+        [1024, 4096],
+    ),
+    "shallow_water": Kernel(
+        "shallow_water.py",
+        lambda n, dt, it: ["-n", str(n), "-t", "-d", dt],
+        2,
+        [1024, 4096],
+    ),
+    "black_scholes": Kernel(
+        "black_scholes.py",
+        lambda n, dt, it: ["-n", str(n), "-i", str(it), "-d", dt],
+        1,
+        [1 << 20, 1 << 24],
+    ),
+}
+
+
+def scaled_size(kernel, size, ranks, mode):
+    if mode == "strong":
+        return size
+    # constant work per rank
+    return int(round(size * ranks ** (1.0 / kernel.dims)))
+
+
+def run_one(name, kernel, size, ranks, args):
+    with tempfile.TemporaryDirectory() as tmp:
+        out = os.path.join(tmp, "result.json")
+        cmd = [sys.executable, "-u", os.path.join(EXAMPLES, kernel.script)]
+        cmd += kernel.args(size, args.datatype, args.iterations)
+        if ranks > 1:
+            cmd = shlex.split(args.launcher.format(ranks=ranks)) + cmd
+        env = dict(os.environ, SHARPY_BENCH_JSON=out)
+        print(" ".join(cmd), flush=True)
+        try:
+            cp = subprocess.run(
+                cmd,
+                env=env,
+                cwd=EXAMPLES,
+                capture_output=True,
+                text=True,
+                timeout=args.timeout,
+            )
+        except subprocess.TimeoutExpired:
+            return {"error": f"timeout after {args.timeout} s"}
+        if cp.returncode != 0 or not os.path.exists(out):
+            print(cp.stdout[-2000:], cp.stderr[-2000:], file=sys.stderr)
+            return {"error": f"exit code {cp.returncode}"}
+        with open(out) as f:
+            return json.load(f)
+
+
+def efficiency(results):
+    # relative to the run with the fewest ranks of the same configuration
+    base = {}
+    for r in results:
+        if "median_s" not in r:
+            continue
+        key = (r["kernel"], r["mode"], r["base_size"])
+        if key not in base or r["ranks"] < base[key]["ranks"]:
+            base[key] = r
+    for r in results:
+        b = base.get((r["kernel"], r["mode"], r["base_size"]))
+        if "median_s" not in r or not b or not r["median_s"]:
+            continue
+        speedup = b["median_s"] / r["median_s"]
+        if r["mode"] == "strong":
+            speedup *= b["ranks"]
+            r["efficiency"] = speedup / r["ranks"]
+        else:
+            r["efficiency"] = speedup
+
+
+def git_commit():
+    try:
+        return subprocess.run(
+            ["git", "describe", "--always", "--dirty"],
+            cwd=EXAMPLES,
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def key_of(r):
+    return (r["kernel"], r["mode"], r["ranks"], r["size"], r["datatype"])
+
+
+def report(results):
+    print(
+        f"{'kernel':<14} {'mode':<6} {'ranks':>5} {'size':>10} "
+        f"{'first [s]':>10} {'compile [s]':>11} {'median [s]':>10} "
+        f"{'Mwork/s':>10} {'eff':>5}"
+    )
+    for r in results:
+        if "error" in r:
+            print(
+                f"{r['kernel']:<14} {r['mode']:<6} {r['ranks']:>5} "
+                f"{r['size']:>10} {r['error']}"
+            )
+            continue
+        tp = r.get("throughput")
+        print(
+            f"{r['kernel']:<14} {r['mode']:<6} {r['ranks']:>5} "
+            f"{r['size']:>10} {r['first_s']:>10.4f} "
+            f"{r.get('compile_s', 0):>11.4f} {r.get('median_s', 0):>10.5f} "
+            f"{tp / 1e6 if tp else 0:>10.2f} {r.get('efficiency', 0):>5.2f}"
+        )
+
+
+def run(args):
+    names = args.kernels or list(KERNELS)
+    results = []
+    for name in names:
+        kernel = KERNELS[name]
+        for base_size in args.sizes or kernel.sizes:
+            for ranks in args.ranks:
+                size = scaled_size(kernel, base_size, ranks, args.mode)
+                res = run_one(name, kernel, size, ranks, args)
+                res.update(
+                    {
+                        "kernel": name,
+                        "mode": args.mode,
+                        "ranks": ranks,
+                        "size": size,
+                        "base_size": base_size,
+                        "datatype": args.datatype,
+                    }
+                )
+                results.append(res)
+    efficiency(results)
+
+    out = {
+        "commit": git_commit(),
+        "date": datetime.datetime.now().isoformat(),
+        "host": platform.node(),
+        "python": platform.python_version(),
+        "env": {k: v for k, v in os.environ.items() if k.startswith("SHARPY")},
+        "results": results,
+    }
+    with open(args.output, "w") as f:
+        json.dump(out, f, indent=1)
+    report(results)
+    print(args.output)
+    return 1 if any("error" in r for r in results) else 0
+
+
+def compare(args):
+    with open(args.base) as f:
+        base = {key_of(r): r for r in json.load(f)["results"]}
+    with open(args.new) as f:
+        new = json.load(f)["results"]
+
+    print(
+        f"{'kernel':<14} {'mode':<6} {'ranks':>5} {'size':>10} "
+        f"{'base [s]':>10} {'new [s]':>10} {'ratio':>6}"
+    )
+    regressions = 0
+    for r in new:
+        b = base.get(key_of(r))
+        if not b or "median_s" not in b or "median_s" not in r:
+            continue
+        # > 1 is faster
+        ratio = b["median_s"] / r["median_s"]
+        flag = ""
+        if ratio < 1.0 - args.threshold:
+            flag = " REGRESSION"
+            regressions += 1
+        print(
+            f"{r['kernel']:<14} {r['mode']:<6} {r['ranks']:>5} "
+            f"{r['size']:>10} {b['median_s']:>10.5f} {r['median_s']:>10.5f} "
+            f"{ratio:>6.3f}{flag}"
+        )
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Run scaling benchmarks of the examples",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser(
+        "run",
+        help="Run benchmarks",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    p.add_argument(
+        "-k",
+        "--kernels",
+        nargs="+",
+        choices=list(KERNELS),
+        help="Kernels to run, all if not given.",
+    )
+    p.add_argument(
+        "-s",
+        "--sizes",
+        nargs="+",
+        type=int,
+        help="Problem sizes, kernel defaults if not given.",
+    )
+    p.add_argument(
+        "-r",
+        "--ranks",
+        nargs="+",
+        type=int,
+        default=[1],
+        help="Numbers of ranks.",
+    )
+    p.add_argument(
+        "-m",
+        "--mode",
+        choices=["strong", "weak"],
+        default="strong",
+        help="Scaling mode.",
+    )
+    p.add_argument(
+        "-d",
+        "--datatype",
+        choices=["f32", "f64"],
+        default="f64",
+        help="Datatype, if supported by the kernel.",
+    )
+    p.add_argument(
+        "-i",
+        "--iterations",
+        type=int,
+        default=10,
+        help="Iterations, if supported by the kernel.",
+    )
+    p.add_argument(
+        "-l",
+        "--launcher",
+        default="mpirun -n {ranks}",
+        help="Command prefix for runs with more than one rank.",
+    )
+    p.add_argument(
+        "-t",
+        "--timeout",
+        type=float,
+        default=3600,
+        help="Timeout of a single run in seconds.",
+    )
+    p.add_argument(
+        "-o", "--output", default="sharpy_scaling.json", help="Output file."
+    )
+    p.set_defaults(func=run)
+
+    p = sub.add_parser(
+        "compare",
+        help="Compare steady-state times of two runs",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    p.add_argument("base", help="Baseline JSON file.")
+    p.add_argument("new", help="JSON file to compare to the baseline.")
+    p.add_argument(
+        "--threshold",
+        type=float,
+        default=0.05,
+        help="Relative slowdown reported as regression.",
+    )
+    p.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    sys.exit(args.func(args))
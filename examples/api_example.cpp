@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Using sharpy from a C++ main through the C++ API (see api.hpp): creates
+  arrays, computes with them and checks the results on every process.
+
+  Build with -DSHARPY_CXX_API=ON, run with the path to libidtr.so, e.g.
+    mpirun -n 4 sharpy_api_example /path/to/libidtr.so
+  Returns non-zero if a result is wrong. Also run by ctest.
+*/
+
+#include <sharpy/api.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace api = SHARPY::api;
+
+static int nErrors = 0;
+
+static void check(bool ok, const std::string &what) {
+  if (!ok) {
+    std::cerr << "[" << api::rank() << "] FAILED: " << what << std::endl;
+    ++nErrors;
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <path to libidtr.so>" << std::endl;
+    return 2;
+  }
+  api::init(argv[1]);
+  {
+    const int64_t n = 16;
+    auto nr = static_cast<int64_t>(api::nranks());
+    auto me = static_cast<int64_t>(api::rank());
+
+    // create, compute, reduce
+    auto a = api::full({n, 8}, 1.0, SHARPY::FLOAT64);
+    auto b = a * 2.0 + a;
+    check(b.shape() == api::shape_t({n, 8}), "shape");
+    check(api::to_scalar(api::sum(b)) == 3.0 * n * 8, "sum");
+
+    // gather the distributed array on all processes
+    std::vector<double> all(n * 8);
+    api::gather(b, all.data());
+    bool same = true;
+    for (auto v : all) {
+      same = same && v == 3.0;
+    }
+    check(same, "gather");
+
+    // local blocks become partitions of a distributed array
+    auto c = api::from_local(std::vector<int64_t>(4, me), {4});
+    check(c.shape() == api::shape_t({4 * nr}), "from_local shape");
+    check(api::to_scalar(api::sum(c)) == 4.0 * nr * (nr - 1) / 2,
+          "from_local sum");
+    auto part = api::local(c);
+    check(part.shape == api::shape_t({4}) &&
+              part.offsets == api::shape_t({4 * me}),
+          "local part");
+    api::sync();
+  }
+  api::fini();
+  return nErrors ? 1 : 0;
+}
@@ -25,10 +25,10 @@ Examples:
 
 import argparse
 import os
-import time as time_mod
 from functools import partial
 
 import numpy
+from timing import Timer
 
 try:
     import mpi4py
@@ -212,38 +212,22 @@ def run(nopt, backend, iterations, datatype):
     args = initialize(create_full, nopt, seed, dtype)
     sync()
 
-    def eval():
-        tic = time_mod.perf_counter()
-        black_scholes(np, erf, nopt, *args)
-        sync()
-        toc = time_mod.perf_counter()
-        return toc - tic
-
-    # warm-up run
-    t_warm = eval()
+    timer = Timer(
+        "black_scholes",
+        sync,
+        backend=backend,
+        nopt=nopt,
+        datatype=datatype,
+    )
 
-    # evaluate
+    # warm-up run + iterations
     info(f"Running {iterations} iterations")
-    time_list = []
-    for i in range(iterations):
-        time_list.append(eval())
-
-    # get max time over mpi ranks
-    if comm is not None:
-        t_warm = comm.allreduce(t_warm, MPI.MAX)
-        time_list = comm.allreduce(time_list, MPI.MAX)
-
-    t_min = numpy.min(time_list)
-    t_max = numpy.max(time_list)
-    t_med = numpy.median(time_list)
-    perf_rate = nopt / t_med / 1e6  # million options per second
-    init_overhead = t_warm - t_med
-    if backend == "sharpy":
-        info(f"Estimated initialization overhead: {init_overhead:.5f} s")
-    info(f"Min.   duration: {t_min:.5f} s")
-    info(f"Max.   duration: {t_max:.5f} s")
-    info(f"Median duration: {t_med:.5f} s")
-    info(f"Median rate: {perf_rate:.5f} Mopts/s")
+    for i in range(iterations + 1):
+        with timer:
+            black_scholes(np, erf, nopt, *args)
+
+    # million options per second
+    timer.report(work=nopt, unit="opts")
 
     # verify
     call, put = args[-2], args[-1]
@@ -31,6 +31,7 @@ import time as time_mod
 from functools import partial
 
 import numpy
+from timing import Timer
 
 try:
     import mpi4py
@@ -334,6 +335,14 @@ def run(n, backend, datatype, benchmark_mode):
     next_t_export = 0
     initial_v = None
     initial_e = None
+    timer = Timer(
+        "shallow_water",
+        sync,
+        backend=backend,
+        n=n,
+        datatype=datatype,
+        benchmark_mode=benchmark_mode,
+    )
     tic = time_mod.perf_counter()
     block_tic = 0
     for i in range(nt + 1):
@@ -392,12 +401,15 @@ def run(n, backend, datatype, benchmark_mode):
             sync()
             block_tic = time_mod.perf_counter()
 
-        step(u, v, e, u1, v1, e1, u2, v2, e2)
+        with timer:
+            step(u, v, e, u1, v1, e1, u2, v2, e2)
 
     sync()
 
     duration = time_mod.perf_counter() - tic
     info(f"Duration: {duration:.2f} s")
+    # grid cells updated per second
+    timer.report(work=nx * ny, unit="cells")
 
     e_exact = exact_solution(t, x_t_2d, y_t_2d, x_u_2d, y_u_2d, x_v_2d, y_v_2d)[
         2
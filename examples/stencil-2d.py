@@ -60,13 +60,10 @@ print(
     "Python version = ",
     str(sys.version_info.major) + "." + str(sys.version_info.minor),
 )
-if sys.version_info >= (33, 3):
-    from time import process_time as timer
-else:
-    from timeit import default_timer as timer
 
 import sharpy as np
 import sharpy.numpy
+from timing import Timer
 
 # print('np version  = ', np.version.version)
 
@@ -122,7 +119,6 @@ def main():
 
     # there is certainly a more Pythonic way to initialize W,
     # but it will have no impact on performance.
-    t0 = timer()
     W = np.zeros(((2 * r + 1), (2 * r + 1)), dtype=np.float32, device=device)
     B = np.zeros((n, n), dtype=np.float32, device=device)
 
@@ -150,11 +146,10 @@ def main():
         lambda i, j: i + j, (n, n), dtype=np.float32, device=device
     )
 
+    # the first iteration is a warmup iteration
+    timer = Timer("stencil-2d", np.sync, n=n, pattern=pattern, radius=r)
     for k in range(iterations + 1):
-        # start timer after a warmup iteration
-        np.sync()
-        if k <= 1:
-            t0 = timer()
+        timer.start()
 
         if pattern == "star":
             if r == 2:
@@ -188,10 +183,11 @@ def main():
                             W[r + t, r + s] * A[r + t : b + t, r + s : b + s]
                         )
         A[:, :] = A + 1.0
+        timer.stop()
 
-    np.sync()
-    t1 = timer()
-    stencil_time = t1 - t0
+    active_points = (n - 2 * r) ** 2
+    flops = (2 * stencil_size + 1) * active_points
+    timer.report(work=flops, unit="flops")
 
     # ******************************************************************************
     # * Analyze and output results.
@@ -199,7 +195,6 @@ def main():
 
     B = np.spmd.gather(np.reshape(B, (n * n,)))
     norm = np.linalg.norm(B, ord=1)
-    active_points = (n - 2 * r) ** 2
     norm /= active_points
 
     epsilon = 1.0e-8
@@ -212,14 +207,6 @@ def main():
         print(
             "ERROR: L1 norm = ", norm, " Reference L1 norm = ", reference_norm
         )
-    flops = (2 * stencil_size + 1) * active_points
-    avgtime = stencil_time / iterations
-    print(
-        "Rate (MFlops/s): ",
-        1.0e-6 * flops / avgtime,
-        " Avg time (s): ",
-        avgtime,
-    )
 
 
 if __name__ == "__main__":
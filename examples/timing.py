@@ -0,0 +1,130 @@
+"""
+Common timing of the examples.
+
+Each example times its iterations with a Timer. The first iteration
+includes jit compilation and is reported separately from the remaining
+(steady-state) iterations. Reported times are the maximum over MPI ranks.
+
+With SHARPY_BENCH_JSON=<file> rank 0 also writes the results as JSON to
+<file>. benchmarks/scaling.py uses this to run the examples over problem
+sizes and rank counts.
+"""
+
+import json
+import os
+import time as time_mod
+
+import numpy
+
+try:
+    import mpi4py
+
+    mpi4py.rc.finalize = False
+    from mpi4py import MPI
+
+    comm = MPI.COMM_WORLD
+except ImportError:
+    comm = None
+
+
+class Timer:
+    """
+    Times iterations of an example, use as context manager:
+
+        timer = Timer("my_kernel", sync, n=n)
+        for i in range(iterations):
+            with timer:
+                kernel()
+        timer.report(work=n, unit="elements")
+
+    or call start() and stop() around each iteration.
+
+    sync waits for all pending computation. params describe the run and are
+    included in the JSON output.
+    """
+
+    def __init__(self, name, sync, **params):
+        self.name = name
+        self.sync = sync
+        self.params = params
+        self.times = []
+
+    def start(self):
+        self.sync()
+        self.tic = time_mod.perf_counter()
+
+    def stop(self):
+        self.sync()
+        self.times.append(time_mod.perf_counter() - self.tic)
+
+    def __enter__(self):
+        self.start()
+        return self
+
+    def __exit__(self, *args):
+        self.stop()
+
+    def report(self, work=None, unit=None):
+        """
+        Print timing of first and steady-state iterations on rank 0.
+        work is the amount of work per iteration in units of unit and
+        determines the throughput (work per second).
+        Returns the result, a dict.
+        """
+        times = numpy.array(self.times, dtype=numpy.float64)
+        nranks = 1
+        rank = 0
+        if comm is not None:
+            # the slowest rank determines the time of an iteration
+            comm.Allreduce(MPI.IN_PLACE, times, op=MPI.MAX)
+            nranks = comm.Get_size()
+            rank = comm.Get_rank()
+
+        res = {
+            "name": self.name,
+            "params": self.params,
+            "nranks": nranks,
+            "iterations": len(times),
+            "first_s": float(times[0]) if len(times) else None,
+        }
+        steady = times[1:]
+        if len(steady):
+            median = float(numpy.median(steady))
+            res.update(
+                {
+                    "min_s": float(numpy.min(steady)),
+                    "median_s": median,
+                    "mean_s": float(numpy.mean(steady)),
+                    "max_s": float(numpy.max(steady)),
+                    # first iteration minus a typical one, mostly compilation
+                    "compile_s": max(res["first_s"] - median, 0.0),
+                }
+            )
+            if work:
+                res.update(
+                    {
+                        "work": work,
+                        "unit": unit,
+                        "throughput": work / median if median > 0 else None,
+                    }
+                )
+
+        if rank == 0:
+            if len(times):
+                print(f"First iteration: {res['first_s']:.5f} s")
+            if len(steady):
+                print(f"Estimated compile time: {res['compile_s']:.5f} s")
+                print(
+                    f"Steady state ({len(steady)} iterations): "
+                    f"min {res['min_s']:.5f} s, "
+                    f"median {res['median_s']:.5f} s, "
+                    f"max {res['max_s']:.5f} s"
+                )
+                if res.get("throughput"):
+                    print(f"Rate: {res['throughput'] / 1e6:.5f} M{unit}/s")
+
+            fname = os.getenv("SHARPY_BENCH_JSON")
+            if fname:
+                with open(fname, "w") as f:
+                    json.dump(res, f)
+        return res
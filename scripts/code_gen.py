@@ -18,6 +18,7 @@ print(
 #ifdef DEF_PY11_ENUMS
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <utility>
 namespace py = pybind11;
 #endif
 
@@ -46,7 +47,17 @@ for cat, lst in api.api_categories.items():
         print(f'        .value("{x.upper()}", {x.upper()})')
     print("        .export_values();\n")
 
-print("}\n#endif\n} // namespace SHARPY")
+print("}\n")
+
+# Python operators (dunder methods) get bound directly to the native array
+for cat in ["EWBinOp", "EWUnyOp"]:
+    print(f"static const std::pair<const char *, {cat}Id> {cat}Dunders[] = {{")
+    for x in api.api_categories[cat]:
+        if x.startswith("__"):
+            print(f'    {{"{x}", {x.upper()}}},')
+    print("};\n")
+
+print("#endif\n} // namespace SHARPY")
 
 # Close the file
 sys.stdout.close()
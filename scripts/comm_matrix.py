@@ -0,0 +1,88 @@
+"""
+Merge the per-rank communication profiles written with
+SHARPY_COMM_STATS=<prefix> into a rank-to-rank byte matrix and totals per
+collective and call site.
+
+Usage: python comm_matrix.py <prefix> [output]
+Reads <prefix>.<rank>.json for all ranks, writes output (default
+<prefix>.json) and prints the most expensive collectives. matrix[i][j] is
+the number of bytes rank i sent to rank j (allreduce not included).
+"""
+
+import glob
+import json
+import re
+import sys
+
+
+def merge(prefix, output=None):
+    pattern = re.compile(re.escape(prefix) + r"\.(\d+)\.json$")
+    files = sorted(
+        (int(m.group(1)), f)
+        for f in glob.glob(glob.escape(prefix) + ".*.json")
+        if (m := pattern.search(f))
+    )
+    if not files:
+        raise FileNotFoundError(f"No profiles found for prefix {prefix}")
+
+    ranks = [r for r, _ in files]
+    if ranks != list(range(len(ranks))):
+        print(
+            f"Warning: profiles missing, found ranks {ranks}", file=sys.stderr
+        )
+
+    nranks = 0
+    rows = {}
+    totals = {}
+    for rank, fname in files:
+        with open(fname) as f:
+            prof = json.load(f)
+        nranks = max(nranks, prof["nranks"])
+        rows[rank] = prof["sent"]
+        for c in prof["collectives"]:
+            t = totals.setdefault(
+                (c["collective"], c["site"]),
+                {"calls": 0, "bytes": 0, "ns": 0, "wait_ns": 0, "max_ns": 0},
+            )
+            t["calls"] += c["calls"]
+            t["bytes"] += c["bytes"]
+            t["ns"] += c["ns"]
+            t["wait_ns"] += c["wait_ns"]
+            # the slowest rank determines the time of a collective
+            t["max_ns"] = max(t["max_ns"], c["ns"] + c["wait_ns"])
+
+    matrix = [rows.get(i, [0] * nranks) for i in range(nranks)]
+    collectives = sorted(
+        ({"collective": c, "site": s, **t} for (c, s), t in totals.items()),
+        key=lambda x: x["max_ns"],
+        reverse=True,
+    )
+
+    output = output or prefix + ".json"
+    with open(output, "w") as f:
+        json.dump(
+            {"nranks": nranks, "collectives": collectives, "matrix": matrix}, f
+        )
+    return output, collectives
+
+
+def report(collectives, top=10):
+    print(
+        f"{'collective':<12} {'site':<12} {'calls':>8} {'MB':>10} "
+        f"{'time [ms]':>10} {'wait [ms]':>10} {'max [ms]':>10}"
+    )
+    for c in collectives[:top]:
+        print(
+            f"{c['collective']:<12} {c['site']:<12} {c['calls']:>8} "
+            f"{c['bytes'] / 1e6:>10.3f} {c['ns'] / 1e6:>10.3f} "
+            f"{c['wait_ns'] / 1e6:>10.3f} {c['max_ns'] / 1e6:>10.3f}"
+        )
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in (2, 3):
+        print(__doc__)
+        sys.exit(1)
+    output, collectives = merge(*sys.argv[1:])
+    report(collectives)
+    print(output)
@@ -0,0 +1,48 @@
+"""
+Merge the per-rank traces written with SHARPY_TRACE=<prefix> into a single
+Chrome/Perfetto trace (open it in https://ui.perfetto.dev or
+chrome://tracing).
+
+Usage: python merge_traces.py <prefix> [output]
+Reads <prefix>.<rank>.json for all ranks, writes output (default
+<prefix>.json). Ranks show up as processes, timestamps are wall-clock times
+and hence only as well aligned as the clocks of the nodes.
+"""
+
+import glob
+import json
+import re
+import sys
+
+
+def merge(prefix, output=None):
+    pattern = re.compile(re.escape(prefix) + r"\.(\d+)\.json$")
+    files = sorted(
+        (int(m.group(1)), f)
+        for f in glob.glob(glob.escape(prefix) + ".*.json")
+        if (m := pattern.search(f))
+    )
+    if not files:
+        raise FileNotFoundError(f"No traces found for prefix {prefix}")
+
+    events = []
+    for rank, fname in files:
+        with open(fname) as f:
+            events.extend(json.load(f)["traceEvents"])
+    ranks = [r for r, _ in files]
+    if ranks != list(range(len(ranks))):
+        print(f"Warning: traces missing, found ranks {ranks}", file=sys.stderr)
+
+    output = output or prefix + ".json"
+    with open(output, "w") as f:
+        json.dump(
+            {"traceEvents": events, "otherData": {"nranks": len(ranks)}}, f
+        )
+    return output
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in (2, 3):
+        print(__doc__)
+        sys.exit(1)
+    print(merge(*sys.argv[1:]))
@@ -5,14 +5,17 @@ https://data-apis.org/array-api/latest
 
 # Many features of the API are very uniformly defined.
 # We make use of that by providing lists of operations which are similar
-# (see array_api.py). __init__.py and sharpy.py simply generate the API
-# by iterating through these lists and forwarding the function calls the the
+# (see array_api.py). __init__.py simply generates the API by iterating
+# through these lists and forwarding the function calls the the
 # C++-extension. Python functions are defined and added by using "eval".
+# The array type itself (ndarray) is native, its operators are bound
+# directly in the C++-extension (see ndarray.py).
 # For many operations we assume the C++-extension defines enums which allow
 # us identifying each operation.
 # At this point there are no checks of input arguments whatsoever, arguments
 # are simply forwarded as-is.
 
+import json
 import os
 import re
 from importlib import import_module
@@ -36,7 +39,8 @@ from ._sharpy import UINT64 as uint64
 from ._sharpy import fini
 from ._sharpy import init as _init
 from ._sharpy import sync
-from .ndarray import ndarray
+from .capture import fori_loop, jit, while_loop
+from .ndarray import GatherWarning, ndarray
 
 _sharpy_cw = bool(int(getenv("SHARPY_CW", False)))
 
@@ -51,22 +55,249 @@ def init(cw=None):
     _init(cw, libidtr)
 
 
-def to_numpy(a):
-    return _csp.to_numpy(a._t)
+def flush_stats(reset=False):
+    """Return statistics about flushes of this process: how often deferred
+    operations had to be compiled and run, how many of them (ops) and how
+    many MLIR operations (kernel_ops) each flush covered, grouped by cause
+    ("scalar", "shape", "to_numpy", "sync", ...). With SHARPY_LOCATIONS=1
+    or SHARPY_FLUSH_WARN=<n> also grouped by the Python line (by_site).
+    Completes all pending operations first. Resets the statistics if reset
+    is True.
+    """
+    sync()
+    res = _csp._flush_stats()
+    if reset:
+        _csp._reset_flush_stats()
+    return res
+
+
+def stats():
+    """Return runtime statistics of this process as a dict: deferred ops,
+    flushes, compiles (with compile_ns and engine-cache hits/misses),
+    kernel executions (with kernel_ns), halo updates, reshapes and
+    reductions (with bytes sent), estimated work of kernels (est_flops,
+    est_bytes, only with SHARPY_ROOFLINE) and the arrays currently alive
+    (live_arrays, live_bytes of local data). Completes all pending
+    operations first. Counters accumulate until reset_stats is called.
+    """
+    sync()
+    return _csp._stats()
+
+
+def reset_stats():
+    """Reset the counters reported by stats and flush_stats."""
+    sync()
+    _csp._reset_stats()
+
+
+def to_numpy(a, root=None):
+    """Gather array a into a numpy array.
+    If root is None, every process gets a copy of the whole array.
+    Otherwise only process root gets the data, all others get None.
+    """
+    return _csp.to_numpy(a, _csp._Ranks._REPLICATED if root is None else root)
+
+
+def to_numpy_async(a, root=None):
+    """Like to_numpy, but returns a concurrent.futures.Future immediately.
+    The future gets resolved once the array is computed and gathered; use
+    asyncio.wrap_future to await it. Must be called collectively.
+    """
+    return _csp._to_numpy_async(
+        a, _csp._Ranks._REPLICATED if root is None else root
+    )
+
+
+def to_numpy_chunks(a, out, chunk_bytes=1 << 26, root=0):
+    """Gather array a in slabs of at most chunk_bytes (along the first
+    dimension, at least one row) and stream them to root.
+    out is either a callable receiving (start_row, numpy_slab) or a writable
+    binary file object to which slabs get written in C-order.
+    Only one slab is kept in memory at any time.
+    If root is None, every process receives all slabs.
+    """
+    callback = out if callable(out) else lambda _start, slab: out.write(slab)
+    _csp._to_numpy_chunks(
+        a,
+        callback,
+        chunk_bytes,
+        _csp._Ranks._REPLICATED if root is None else root,
+    )
+
+
+_MANIFEST = "manifest.json"
+
+
+def _manifest_writer(path, names, compress):
+    def write_manifest(nranks, meta):
+        manifest = {
+            "version": 1,
+            "nranks": nranks,
+            "compression": "zlib" if compress else None,
+            "arrays": {
+                name: {
+                    "dtype": m["dtype"].name,
+                    "shape": list(m["shape"]),
+                    "block_rows": m["block_rows"],
+                    "parts": [list(p) for p in m["parts"]],
+                }
+                for name, m in zip(names, meta)
+            },
+        }
+        with open(os.path.join(path, _MANIFEST), "w") as f:
+            json.dump(manifest, f, indent=1)
+
+    return write_manifest
+
+
+def save(path, arrays, compress=False):
+    """Write a checkpoint of arrays (a dict name -> ndarray) to directory path.
+    Every process writes its local partitions to its own file, in parallel.
+    A small manifest describes global shapes, dtypes and partitions.
+    If compress is True, data gets zlib-compressed.
+    Must be called collectively.
+    """
+    os.makedirs(path, exist_ok=True)
+    names = list(arrays.keys())
+    _csp._save(
+        [arrays[n] for n in names],
+        path,
+        compress,
+        _manifest_writer(path, names, compress),
+    )
+
+
+class SaveHandle:
+    "Handle of a checkpoint written in the background, see save_async."
+
+    def __init__(self, path, names, compress, handle):
+        self._writer = _manifest_writer(path, names, compress)
+        self._handle = handle
+
+    def done(self):
+        "True if this process has written its data. Does not block."
+        return self._handle.done()
+
+    def wait(self):
+        """Block until all processes have written their data, then write the
+        manifest. The checkpoint is complete only after this returned.
+        Must be called collectively.
+        """
+        self._handle.wait(self._writer)
+
+
+def save_async(path, arrays, compress=False):
+    """Like save, but returns immediately with a SaveHandle.
+    The arrays are copied at this point of the program, so they can be
+    modified right away; compression and writing happen in the background.
+    Must be called collectively.
+    """
+    os.makedirs(path, exist_ok=True)
+    names = list(arrays.keys())
+    handle = _csp._AsyncSave([arrays[n] for n in names], path, compress)
+    return SaveHandle(path, names, compress, handle)
+
+
+def load(path, device="", team=1):
+    """Read a checkpoint written by save and return a dict name -> ndarray.
+    The number of processes may differ from the one used for writing; every
+    process reads exactly its new local partition.
+    Must be called collectively.
+    """
+    with open(os.path.join(path, _MANIFEST)) as f:
+        manifest = json.load(f)
+    if manifest.get("version") != 1:
+        raise ValueError(f"Unsupported checkpoint version in {path}")
+    compressed = manifest["compression"] == "zlib"
+    res = {}
+    for name, info in manifest["arrays"].items():
+        a = empty(
+            tuple(info["shape"]),
+            dtype=getattr(_csp, info["dtype"]),
+            device=device,
+            team=team,
+        )
+        _csp._load(a, path, info["parts"], info["block_rows"], compressed)
+        res[name] = a
+    return res
+
+
+def from_dlpack(x):
+    """Wrap a DLPack-compatible array (or capsule) as the local partition
+    of a distributed sharpy array without copying. x must reside in host
+    memory. Like spmd.from_locals, local arrays are stacked along the first
+    axis in rank order. Must be called collectively.
+    """
+    capsule = x.__dlpack__() if hasattr(x, "__dlpack__") else x
+    return _csp._from_dlpack(capsule)
+
+
+def load_raw(path, shape, dtype=float64, offset=0, device="", team=1):
+    """Load a distributed array from a raw binary file holding the data in
+    C-order, starting at byte offset.
+    Every process reads only the byte ranges of its own partition.
+    Must be called collectively.
+    """
+    a = empty(tuple(shape), dtype=dtype, device=device, team=team)
+    _csp._load_raw(a, os.fspath(path), offset)
+    return a
+
+
+def load_npy(path, split_axis=0, device="", team=1):
+    """Load a distributed array from a .npy file.
+    The header is parsed, then every process reads only the byte ranges of
+    its own partition; no process reads the whole file.
+    Only split_axis=0 and C-ordered files are supported.
+    Must be called collectively.
+    """
+    import numpy as np
+
+    if split_axis != 0:
+        raise NotImplementedError("load_npy only supports split_axis=0")
+    with open(path, "rb") as f:
+        version = np.lib.format.read_magic(f)
+        if version == (1, 0):
+            hdr = np.lib.format.read_array_header_1_0(f)
+        elif version == (2, 0):
+            hdr = np.lib.format.read_array_header_2_0(f)
+        else:
+            raise ValueError(f"Unsupported .npy version {version}")
+        shape, fortran_order, npdtype = hdr
+        offset = f.tell()
+    if fortran_order and len(shape) > 1:
+        raise NotImplementedError("load_npy does not support Fortran order")
+    if not npdtype.isnative:
+        raise NotImplementedError("load_npy requires native byte order")
+    dtype = {
+        "float64": float64,
+        "float32": float32,
+        "int64": int64,
+        "int32": int32,
+        "int16": int16,
+        "int8": int8,
+        "uint64": uint64,
+        "uint32": uint32,
+        "uint16": uint16,
+        "uint8": uint8,
+        "bool": _bool,
+    }.get(npdtype.name)
+    if dtype is None:
+        raise ValueError(f"Unsupported dtype {npdtype}")
+    return load_raw(path, shape, dtype, offset, device, team)
 
 
 for op in api.api_categories["EWBinOp"]:
     if not op.startswith("__"):
         OP = op.upper()
         exec(
-            f"{op} = lambda this, other: ndarray(_csp.EWBinOp.op(_csp.{OP}, this._t if isinstance(this, ndarray) else this, other._t if isinstance(other, ndarray) else other))"
+            f"{op} = lambda this, other: _csp.EWBinOp.op(_csp.{OP}, this, other)"
         )
 
 for op in api.api_categories["EWUnyOp"]:
     if not op.startswith("__"):
         OP = op.upper()
         exec(
-            f"{op} = lambda this: ndarray(_csp.EWUnyOp.op(_csp.{OP}, this._t))"
+            f"{op} = lambda this: _csp.EWUnyOp.op(_csp.{OP}, this)"
         )
 
 
@@ -84,27 +315,27 @@ for func in api.api_categories["Creator"]:
     FUNC = func.upper()
     if func == "full":
         exec(
-            f"{func} = lambda shape, val, dtype=float64, device='', team=1: ndarray(_csp.Creator.full(shape, val, dtype, _validate_device(device), team))"
+            f"{func} = lambda shape, val, dtype=float64, device='', team=1: _csp.Creator.full(shape, val, dtype, _validate_device(device), team)"
         )
     elif func == "empty":
         exec(
-            f"{func} = lambda shape, dtype=float64, device='', team=1: ndarray(_csp.Creator.full(shape, None, dtype, _validate_device(device), team))"
+            f"{func} = lambda shape, dtype=float64, device='', team=1: _csp.Creator.full(shape, None, dtype, _validate_device(device), team)"
         )
     elif func == "ones":
         exec(
-            f"{func} = lambda shape, dtype=float64, device='', team=1: ndarray(_csp.Creator.full(shape, 1, dtype, _validate_device(device), team))"
+            f"{func} = lambda shape, dtype=float64, device='', team=1: _csp.Creator.full(shape, 1, dtype, _validate_device(device), team)"
         )
     elif func == "zeros":
         exec(
-            f"{func} = lambda shape, dtype=float64, device='', team=1: ndarray(_csp.Creator.full(shape, 0, dtype, _validate_device(device), team))"
+            f"{func} = lambda shape, dtype=float64, device='', team=1: _csp.Creator.full(shape, 0, dtype, _validate_device(device), team)"
         )
     elif func == "arange":
         exec(
-            f"{func} = lambda start, end, step, dtype=int64, device='', team=1: ndarray(_csp.Creator.arange(start, end, step, dtype, _validate_device(device), team))"
+            f"{func} = lambda start, end, step, dtype=int64, device='', team=1: _csp.Creator.arange(start, end, step, dtype, _validate_device(device), team)"
         )
     elif func == "linspace":
         exec(
-            f"{func} = lambda start, end, step, endpoint, dtype=float64, device='', team=1: ndarray(_csp.Creator.linspace(start, end, step, endpoint, dtype, _validate_device(device), team))"
+            f"{func} = lambda start, end, step, endpoint, dtype=float64, device='', team=1: _csp.Creator.linspace(start, end, step, endpoint, dtype, _validate_device(device), team)"
         )
 
 
@@ -112,13 +343,13 @@ for func in api.api_categories["ManipOp"]:
     FUNC = func.upper()
     if func == "reshape":
         exec(
-            f"{func} = lambda this, shape, cp=None: ndarray(_csp.ManipOp.reshape(this._t, shape, cp))"
+            f"{func} = lambda this, shape, cp=None: _csp.ManipOp.reshape(this, shape, cp)"
         )
 
 for func in api.api_categories["ReduceOp"]:
     FUNC = func.upper()
     exec(
-        f"{func} = lambda this, dim=None: ndarray(_csp.ReduceOp.op(_csp.{FUNC}, this._t, dim if dim else []))"
+        f"{func} = lambda this, dim=None: _csp.ReduceOp.op(_csp.{FUNC}, this, dim if dim else [])"
     )
 
 for func in api.api_categories["LinAlgOp"]:
@@ -128,14 +359,14 @@ for func in api.api_categories["LinAlgOp"]:
         "vecdot",
     ]:
         exec(
-            f"{func} = lambda this, other, axis: ndarray(_csp.LinAlgOp.{func}(this._t, other._t, axis))"
+            f"{func} = lambda this, other, axis: _csp.LinAlgOp.{func}(this, other, axis)"
         )
     elif func == "matmul":
         exec(
-            f"{func} = lambda this, other: ndarray(_csp.LinAlgOp.vecdot(this._t, other._t, 0))"
+            f"{func} = lambda this, other: _csp.LinAlgOp.vecdot(this, other, 0)"
         )
     elif func == "matrix_transpose":
-        exec(f"{func} = lambda this: ndarray(_csp.LinAlgOp.{func}(this._t))")
+        exec(f"{func} = lambda this: _csp.LinAlgOp.{func}(this)")
 
 
 _fb_env = getenv("SHARPY_FALLBACK")
@@ -0,0 +1,206 @@
+"""
+Capturing functions over sharpy arrays (see jit) and loops over them (see
+fori_loop and while_loop).
+
+On its first call with a given set of arguments, a captured function is run
+normally while the jitted function it generates gets recorded. Later calls
+with arrays of the same dtypes, shapes and partitioning (and equal non-array
+arguments) replay the recording without executing the Python function.
+
+The body of a captured loop is executed only once in Python, it generates the
+body of a single scf loop.
+"""
+
+import functools
+import operator
+import warnings
+
+from . import _sharpy as _csp
+from .ndarray import ndarray
+
+
+def _template(res, arrays):
+    """Describe how to build the result res of a captured function from
+    its array arguments and outputs.
+    Returns (kind, positions) and the list of outputs, kind is None if res
+    cannot be captured.
+    """
+    if res is None:
+        return (type(None), []), []
+    if isinstance(res, ndarray):
+        kind, items = ndarray, [res]
+    elif type(res) in (tuple, list) and all(
+        isinstance(x, ndarray) for x in res
+    ):
+        kind, items = type(res), res
+    else:
+        return (None, []), []
+    positions, outs = [], []
+    for x in items:
+        i = next((i for i, a in enumerate(arrays) if a is x), None)
+        if i is not None:
+            positions.append((True, i))
+            continue
+        j = next((j for j, o in enumerate(outs) if o is x), None)
+        if j is None:
+            j = len(outs)
+            outs.append(x)
+        positions.append((False, j))
+    return (kind, positions), outs
+
+
+def _build(tmpl, arrays, outs):
+    kind, positions = tmpl
+    items = [arrays[i] if is_arg else outs[i] for is_arg, i in positions]
+    if kind is type(None):
+        return None
+    if kind is ndarray:
+        return items[0]
+    return kind(items)
+
+
+class JitFunction:
+    """A function which gets replayed from a recording when possible,
+    created by jit."""
+
+    def __init__(self, fn):
+        functools.update_wrapper(self, fn)
+        self._fn = fn
+        # maps arguments to (recording, template) or None if not capturable
+        self._cache = {}
+
+    def _key(self, args, kwargs):
+        arrays, consts = [], []
+        for a in list(args) + [kwargs[k] for k in sorted(kwargs)]:
+            if isinstance(a, ndarray):
+                arrays.append(a)
+                consts.append(ndarray)
+            else:
+                consts.append(a)
+        key = (tuple(sorted(kwargs)), tuple(consts))
+        hash(key)
+        return arrays, (_csp._jit_signature(arrays), key)
+
+    def _record(self, key, arrays, args, kwargs):
+        try:
+            rec = _csp._JitRecording(arrays)
+        except RuntimeError:
+            # e.g. controller/worker mode
+            self._cache[key] = None
+            return self._fn(*args, **kwargs)
+        try:
+            res = self._fn(*args, **kwargs)
+        except BaseException:
+            rec.finish([])
+            raise
+        tmpl, outs = _template(res, arrays)
+        if tmpl[0] is None:
+            rec.finish([])
+            reason = "unsupported return value"
+        else:
+            reason = rec.finish(outs)
+        if reason:
+            warnings.warn(
+                f"sharpy.jit: cannot capture {self.__name__}: {reason}",
+                RuntimeWarning,
+                stacklevel=3,
+            )
+            self._cache[key] = None
+        else:
+            self._cache[key] = (rec, tmpl)
+        return res
+
+    def __call__(self, *args, **kwargs):
+        try:
+            arrays, key = self._key(args, kwargs)
+        except TypeError:
+            # unhashable non-array arguments
+            return self._fn(*args, **kwargs)
+        if not arrays:
+            return self._fn(*args, **kwargs)
+        entry = self._cache.get(key, False)
+        if entry is False or (entry is not None and not entry[0].valid()):
+            return self._record(key, arrays, args, kwargs)
+        if entry is None:
+            return self._fn(*args, **kwargs)
+        rec, tmpl = entry
+        return _build(tmpl, arrays, rec.replay(arrays))
+
+
+def jit(fn):
+    """Decorator capturing the function fn over sharpy arrays.
+
+    The first call for a given combination of array dtypes, shapes and
+    partitioning (and non-array arguments) runs fn and records the jitted
+    function it generates. Later calls replay the recording and neither run
+    the Python code of fn nor defer its operations one by one.
+
+    fn must be a pure function of its arguments: it may only read its array
+    arguments and must return None, an array or a tuple/list of arrays. Its
+    array operations must compile into a single function, e.g. fn must not
+    synchronize or convert arrays to Python values. Otherwise (or in
+    controller/worker mode) fn is simply called every time.
+    """
+    return JitFunction(fn)
+
+
+def _loop_state(state):
+    """Returns the arrays of a loop state and a function building the
+    state from a list of arrays."""
+    if isinstance(state, ndarray):
+        return [state], operator.itemgetter(0)
+    if type(state) in (tuple, list) and all(
+        isinstance(x, ndarray) for x in state
+    ):
+        return list(state), type(state)
+    raise TypeError("Loop state must be an array or a tuple/list of arrays")
+
+
+def _run_loop(loop, body):
+    try:
+        return body()
+    except BaseException:
+        loop.abort()
+        raise
+
+
+def fori_loop(n, body, state):
+    """Compute state = body(i, state) for i in range(n) and return the final
+    state, an array or a tuple/list of arrays.
+
+    The body gets called only once to generate a single loop in the jitted
+    function; the index i is a 0d int64 array. The body must return arrays
+    with the same dtypes and shapes as it got and must not synchronize
+    (e.g. convert arrays to Python values).
+    """
+    n = operator.index(n)
+    if n < 0:
+        raise ValueError("Number of iterations must not be negative")
+    arrays, pack = _loop_state(state)
+    loop = _csp._Loop(arrays, n)
+
+    def trace():
+        i, *args = loop.args()
+        new, _ = _loop_state(body(i, pack(args)))
+        return loop.end(new)
+
+    return pack(_run_loop(loop, trace))
+
+
+def while_loop(cond, body, state):
+    """Compute state = body(state) while cond(state) and return the final
+    state, an array or a tuple/list of arrays.
+
+    cond must return a 0d array, e.g. a reduction, which gets evaluated
+    inside the loop. cond and body get called only once to generate a single
+    loop in the jitted function (see fori_loop).
+    """
+    arrays, pack = _loop_state(state)
+    loop = _csp._Loop(arrays, -1)
+
+    def trace():
+        args = loop.condition(cond(pack(loop.args())))
+        new, _ = _loop_state(body(pack(args)))
+        return loop.end(new)
+
+    return pack(_run_loop(loop, trace))
@@ -6,6 +6,11 @@ array API as defined here: https://data-apis.org/array-api/latest
 #
 # See __init__.py for an implementation overview
 #
+import warnings
+from importlib import import_module
+from numbers import Number
+from types import FunctionType
+
 from . import _sharpy as _csp
 from . import array_api as api
 
@@ -18,51 +23,180 @@ def slicefy(x):
     return slice(x, next_val, 1)
 
 
-class ndarray:
-    def __init__(self, t):
-        self._t = t
+class GatherWarning(UserWarning):
+    "Issued when a distributed array gets gathered implicitly."
 
-    def __repr__(self):
-        return self._t.__repr__()
 
-    for method in api.api_categories["EWBinOp"]:
-        if method.startswith("__"):
-            METHOD = method.upper()
-            exec(
-                f"{method} = lambda self, other: ndarray(_csp.EWBinOp.op(_csp.{METHOD}, self._t, other._t if isinstance(other, ndarray) else other))"
-            )
+# numpy ufunc -> (sharpy function, reflected operator for scalar first args)
+_ufuncs = {
+    "absolute": ("abs", None),
+    "add": ("add", "__radd__"),
+    "arccos": ("acos", None),
+    "arccosh": ("acosh", None),
+    "arcsin": ("asin", None),
+    "arcsinh": ("asinh", None),
+    "arctan": ("atan", None),
+    "arctan2": ("atan2", None),
+    "arctanh": ("atanh", None),
+    "bitwise_and": ("bitwise_and", "__rand__"),
+    "bitwise_or": ("bitwise_or", "__ror__"),
+    "bitwise_xor": ("bitwise_xor", "__rxor__"),
+    "divide": ("divide", "__rtruediv__"),
+    "true_divide": ("divide", "__rtruediv__"),
+    "equal": ("equal", "__eq__"),
+    "floor_divide": ("floor_divide", "__rfloordiv__"),
+    "greater": ("greater", "__lt__"),
+    "greater_equal": ("greater_equal", "__le__"),
+    "invert": ("bitwise_invert", None),
+    "left_shift": ("bitwise_left_shift", "__rlshift__"),
+    "less": ("less", "__gt__"),
+    "less_equal": ("less_equal", "__ge__"),
+    "logical_and": ("logical_and", None),
+    "logical_not": ("logical_not", None),
+    "logical_or": ("logical_or", None),
+    "logical_xor": ("logical_xor", None),
+    "matmul": ("matmul", None),
+    "multiply": ("multiply", "__rmul__"),
+    "not_equal": ("not_equal", "__ne__"),
+    "power": ("pow", "__rpow__"),
+    "remainder": ("remainder", "__rmod__"),
+    "right_shift": ("bitwise_right_shift", "__rrshift__"),
+    "subtract": ("subtract", "__rsub__"),
+}
+for _f in api.api_categories["EWUnyOp"] + api.api_categories["EWBinOp"]:
+    if not _f.startswith("__"):
+        _ufuncs.setdefault(_f, (_f, None))
 
-    for method in api.api_categories["EWUnyOp"]:
-        if method.startswith("__"):
-            METHOD = method.upper()
-            exec(
-                f"{method} = lambda self: ndarray(_csp.EWUnyOp.op(_csp.{METHOD}, self._t))"
-            )
+# ufunc.reduce -> sharpy reduction
+_ufunc_reductions = {
+    "add": "sum",
+    "multiply": "prod",
+    "maximum": "max",
+    "minimum": "min",
+}
 
-    for method in api.api_categories["UnyOp"]:
-        exec(f"{method} = lambda self: self._t.{method}()")
+# numpy function -> sharpy function; reductions accept axis
+_functions = {
+    "amax": "max",
+    "amin": "min",
+    "matmul": "matmul",
+    "reshape": "reshape",
+}
+for _f in api.api_categories["ReduceOp"]:
+    _functions[_f] = _f
 
-    for att in api.attributes:
-        exec(f"{att} = property(lambda self: self._t.{att})")
 
-    def astype(self, dtype, copy=False):
-        return ndarray(self._t.astype(dtype, copy))
+def _sp():
+    "the sharpy module, imported lazily to avoid a circular import"
+    return import_module(__package__)
 
-    def to_device(self, device=""):
-        return ndarray(self._t.to_device(device))
 
-    def __getitem__(self, key):
-        key = key if isinstance(key, tuple) else (key,)
-        key = [slicefy(x) for x in key]
-        return ndarray(self._t.__getitem__(key))
+def _axis(axis):
+    if axis is None:
+        return None
+    return list(axis) if isinstance(axis, (tuple, list)) else [axis]
 
-    def __setitem__(self, key, value):
-        key = key if isinstance(key, tuple) else (key,)
-        key = [slicefy(x) for x in key]
-        if isinstance(value, ndarray) and value._t.dtype != self._t.dtype:
-            raise ValueError(
-                f"Mismatching data type in setitem: {value._t.dtype}, expecting {self._t.dtype}"
-            )
-        self._t.__setitem__(
-            key, value._t if isinstance(value, ndarray) else value
+
+# The array type is native, operators go straight to C++.
+# Below we add methods which are easier to have in Python.
+ndarray = _csp.ndarray
+
+
+class _methods:
+    def __array_namespace__(self, /, *, api_version=None):
+        return _sp()
+
+    def item(self, *idx):
+        """Return the element at index idx as a Python scalar.
+        Much cheaper than float(a[idx]): the owning process broadcasts the
+        value directly.
+        """
+        if len(idx) == 1 and isinstance(idx[0], tuple):
+            idx = idx[0]
+        return self._item(list(idx))
+
+    def itemset(self, *args):
+        """Set a single element: a.itemset(*idx, value).
+        Only the owning process writes, no communication involved.
+        """
+        if len(args) < 1:
+            raise TypeError("itemset must have at least one argument")
+        idx = args[:-1]
+        if len(idx) == 1 and isinstance(idx[0], tuple):
+            idx = idx[0]
+        self._itemset(list(idx), args[-1])
+
+    def __array__(self, dtype=None, copy=None):
+        if copy is False:
+            raise ValueError("sharpy arrays cannot be converted without a copy")
+        warnings.warn(
+            "Implicitly gathering a distributed sharpy array into numpy;"
+            " use sharpy.to_numpy() to make this explicit.",
+            GatherWarning,
+            stacklevel=2,
         )
+        res = _csp.to_numpy(self, _csp._Ranks._REPLICATED)
+        return res if dtype is None else res.astype(dtype)
+
+    def __array_ufunc__(self, ufunc, method, *inputs, **kwargs):
+        """Run numpy ufuncs on sharpy arrays as sharpy operations.
+        Returns NotImplemented (numpy raises TypeError) for anything we do not
+        support, including numpy arrays as operands, so nothing gets gathered
+        behind the user's back.
+        """
+        if kwargs.pop("out", None) is not None:
+            return NotImplemented
+        if kwargs.pop("where", True) is not True:
+            return NotImplemented
+        if any(k != "axis" for k in kwargs):
+            return NotImplemented
+        if not all(isinstance(x, (ndarray, Number)) for x in inputs):
+            return NotImplemented
+        sp = _sp()
+        if method == "reduce":
+            red = _ufunc_reductions.get(ufunc.__name__)
+            if red is None or len(inputs) != 1:
+                return NotImplemented
+            return getattr(sp, red)(inputs[0], _axis(kwargs.get("axis", 0)))
+        if method != "__call__" or "axis" in kwargs:
+            return NotImplemented
+        func, reflected = _ufuncs.get(ufunc.__name__, (None, None))
+        if func is None:
+            return NotImplemented
+        if len(inputs) == 2 and not isinstance(inputs[0], ndarray):
+            if reflected is None:
+                return NotImplemented
+            return getattr(inputs[1], reflected)(inputs[0])
+        return getattr(sp, func)(*inputs)
+
+    def __array_function__(self, func, types, args, kwargs):
+        """Run supported numpy functions as sharpy operations.
+        Everything else returns NotImplemented, e.g. numpy raises TypeError.
+        """
+        if not all(issubclass(t, ndarray) for t in types):
+            return NotImplemented
+        name = _functions.get(func.__name__)
+        if name is None:
+            return NotImplemented
+        sp = _sp()
+        if name in api.api_categories["ReduceOp"]:
+            if len(args) > 2 or any(k != "axis" for k in kwargs):
+                return NotImplemented
+            axis = args[1] if len(args) > 1 else kwargs.get("axis")
+            return getattr(sp, name)(args[0], _axis(axis))
+        if name == "reshape":
+            if kwargs.pop("order", "C") != "C":
+                return NotImplemented
+            shape = (
+                args[1]
+                if len(args) > 1
+                else kwargs.get("shape", kwargs.get("newshape"))
+            )
+            shape = shape if isinstance(shape, (tuple, list)) else [shape]
+            return sp.reshape(args[0], list(shape))
+        return getattr(sp, name)(*args, **kwargs)
+
+
+for _name, _m in list(vars(_methods).items()):
+    if isinstance(_m, FunctionType):
+        setattr(ndarray, _name, _m)
@@ -3,17 +3,48 @@ from . import ndarray
 
 
 def get_slice(obj, *args):
-    return _csp._get_slice(obj._t, *args)
+    return _csp._get_slice(obj, *args)
 
 
 def get_locals(obj):
-    return _csp._get_locals(obj._t, obj)
+    return _csp._get_locals(obj)
+
+
+def get_locals_async(obj):
+    """Like get_locals, but returns a concurrent.futures.Future."""
+    return _csp._get_locals_async(obj)
 
 
 def from_locals(objs):
-    arg = objs if isinstance(objs, (list, tuple)) else [objs]
-    return ndarray.ndarray(_csp._from_locals(arg))
+    """Create distributed arrays from process-local numpy arrays (no copy).
+    Local arrays are stacked along the first axis in rank order and may
+    have different numbers of rows, but dtype and the other dimensions must
+    match across processes. Passing a list creates one array per element,
+    sharing a single metadata exchange. Must be called collectively.
+    """
+    if isinstance(objs, (list, tuple)):
+        return _csp._from_locals(list(objs))
+    return _csp._from_locals([objs])[0]
+
+
+def setitem(obj, key, value, root=_csp._Ranks._REPLICATED):
+    """Assign numpy array value to obj[key].
+    If root is given, value is only needed on process root (ignored on all
+    others) and root sends each process only the part it owns.
+    Otherwise value must be available on all processes.
+    Must be called collectively.
+    """
+    key = key if isinstance(key, tuple) else (key,)
+    key = [ndarray.slicefy(x) for x in key]
+    _csp._set_from_numpy(obj, key, value, root)
 
 
 def gather(obj, root=_csp._Ranks._REPLICATED):
-    return _csp._gather(obj._t, root)
+    return _csp._gather(obj, root)
+
+
+def gather_async(obj, root=_csp._Ranks._REPLICATED):
+    """Like gather, but returns a concurrent.futures.Future.
+    Must be called collectively.
+    """
+    return _csp._gather_async(obj, root)
@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: BSD-3-Clause
 
 #include "sharpy/CollComm.hpp"
+#include "sharpy/CommStats.hpp"
+
+#include <limits>
 
 namespace SHARPY {
 
@@ -22,9 +25,57 @@ void bufferize(NDArray::ptr_type a_ptr, void *outPtr) {
   });
 }
 
+// copy local rows [start, end) of a_ptr into contiguous buffer outPtr
+void bufferize_rows(NDArray::ptr_type a_ptr, int64_t start, int64_t end,
+                           void *outPtr) {
+  if (!outPtr || end <= start)
+    return;
+  dispatch(a_ptr->dtype(), a_ptr->data(),
+           [&a_ptr, start, end, outPtr](auto *ptr) {
+             auto buff = static_cast<decltype(ptr)>(outPtr);
+             auto nd = a_ptr->ndims();
+             auto strides = a_ptr->local_strides();
+             std::vector<int64_t> shp(a_ptr->local_shape(),
+                                      a_ptr->local_shape() + nd);
+             shp[0] = end - start;
+             forall(0, ptr + start * strides[0], shp.data(), strides, nd,
+                    [&buff](const auto *in) {
+                      *buff = *in;
+                      ++buff;
+                    });
+           });
+}
+
+// copy contiguous buffer inPtr into local rows [start, end) of a_ptr
+void unbufferize_rows(NDArray::ptr_type a_ptr, int64_t start, int64_t end,
+                      const void *inPtr) {
+  if (!inPtr || end <= start)
+    return;
+  dispatch(a_ptr->dtype(), a_ptr->data(),
+           [&a_ptr, start, end, inPtr](auto *ptr) {
+             using T = std::remove_pointer_t<decltype(ptr)>;
+             auto buff = static_cast<const T *>(inPtr);
+             auto nd = a_ptr->ndims();
+             if (nd == 0) {
+               ptr[0] = buff[0];
+               return;
+             }
+             auto strides = a_ptr->local_strides();
+             std::vector<int64_t> shp(a_ptr->local_shape(),
+                                      a_ptr->local_shape() + nd);
+             shp[0] = end - start;
+             forall(0, ptr + start * strides[0], shp.data(), strides, nd,
+                    [&buff](auto *out) {
+                      *out = *buff;
+                      ++buff;
+                    });
+           });
+}
+
 // @param outPtr touched only if on root and/or root==REPLICATED or if not
 // distributed
 void gather_array(NDArray::ptr_type a_ptr, rank_type root, void *outPtr) {
+  COMM_SITE("gather");
   auto trscvr = a_ptr->transceiver();
 
   if (!trscvr || a_ptr->owner() == REPLICATED) {
@@ -90,6 +141,81 @@ void gather_array(NDArray::ptr_type a_ptr, rank_type root, void *outPtr) {
     delete[] static_cast<char *>(ptr);
 }
 
+std::vector<int64_t> gather_partitions(NDArray::ptr_type a_ptr) {
+  COMM_SITE("gather");
+  auto trscvr = a_ptr->transceiver();
+  if (!trscvr || a_ptr->owner() == REPLICATED || a_ptr->ndims() == 0) {
+    return {0, a_ptr->ndims() ? a_ptr->shape()[0] : 1};
+  }
+
+  auto nranks = trscvr->nranks();
+  auto myrank = trscvr->rank();
+  std::vector<int> displacements(nranks);
+  std::vector<int> counts(nranks, 2);
+  std::vector<int64_t> parts(2 * nranks);
+  for (size_t i = 0; i < nranks; ++i) {
+    displacements[i] = i * 2;
+  }
+  parts[2 * myrank + 0] = a_ptr->local_offsets()[0]; // FIXME split dim
+  parts[2 * myrank + 1] = a_ptr->local_shape()[0];
+  trscvr->gather(parts.data(), counts.data(), displacements.data(), INT64,
+                 REPLICATED);
+  return parts;
+}
+
+void gather_rows(NDArray::ptr_type a_ptr, const std::vector<int64_t> &parts,
+                 int64_t start, int64_t end, rank_type root, void *outPtr) {
+  COMM_SITE("gather");
+  // not distributed: rows are all local
+  if (parts.size() == 2) {
+    bufferize_rows(a_ptr, start - parts[0], end - parts[0], outPtr);
+    return;
+  }
+
+  auto trscvr = a_ptr->transceiver();
+  auto nranks = trscvr->nranks();
+  auto myrank = trscvr->rank();
+  bool sendonly = root != REPLICATED && root != myrank;
+  auto dtype = a_ptr->dtype();
+  auto gshape = a_ptr->shape();
+  auto nd = a_ptr->ndims();
+  auto myTileSz = std::accumulate(&gshape.data()[1], &gshape.data()[nd],
+                                  int64_t(1), std::multiplies<int64_t>());
+  if ((end - start) * myTileSz > std::numeric_limits<int>::max()) {
+    throw std::overflow_error("Chunk too large for gather.");
+  }
+
+  // compute each pranks contribution: overlap of [start, end) and its
+  // partition
+  std::vector<int> displacements(nranks);
+  std::vector<int> counts(nranks);
+  for (auto i = 0ul; i < nranks; ++i) {
+    auto lo = std::max(start, parts[2 * i]);
+    auto hi = std::min(end, parts[2 * i] + parts[2 * i + 1]);
+    counts[i] = lo < hi ? (hi - lo) * myTileSz : 0;
+    displacements[i] = lo < hi ? (lo - start) * myTileSz : 0;
+  }
+  auto myoff = parts[2 * myrank];
+  auto mylo = std::max(start, myoff) - myoff;
+  auto myhi = std::min(end, myoff + parts[2 * myrank + 1]) - myoff;
+
+  // copy local rows to the right place and gather inplace
+  void *ptr = nullptr;
+  std::vector<char> buff;
+  if (sendonly) {
+    buff.resize(counts[myrank] * sizeof_dtype(dtype));
+    ptr = buff.data();
+    bufferize_rows(a_ptr, mylo, myhi, ptr);
+  } else {
+    ptr = outPtr;
+    bufferize_rows(a_ptr, mylo, myhi,
+                   &(static_cast<char *>(
+                       ptr)[displacements[myrank] * sizeof_dtype(dtype)]));
+  }
+
+  trscvr->gather(ptr, counts.data(), displacements.data(), dtype, root);
+}
+
 // Compute offset and displacements when mapping n_slc to o_slc. This is
 // necessary when slices are not equally partitioned.
 //
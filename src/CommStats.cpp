@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Communication profiling (see CommStats.hpp).
+  Communication can happen in several threads, records are locked.
+*/
+
+#include "sharpy/CommStats.hpp"
+#include "sharpy/Transceiver.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SHARPY {
+namespace comm {
+
+static const std::string prefix =
+    get_prefix_env("SHARPY_COMM_STATS", "sharpy_comm");
+bool _enabled = !prefix.empty();
+thread_local const char *_site = nullptr;
+
+static const char *name(Collective c) {
+  switch (c) {
+  case BARRIER:
+    return "barrier";
+  case BCAST:
+    return "bcast";
+  case ALLREDUCE:
+    return "allreduce";
+  case ALLTOALLV:
+    return "alltoallv";
+  case ALLTOALL:
+    return "alltoall";
+  case ALLGATHERV:
+    return "allgatherv";
+  case GATHERV:
+    return "gatherv";
+  case SCATTERV:
+    return "scatterv";
+  case SENDRECV:
+    return "sendrecv";
+  default:
+    return "unknown";
+  }
+}
+
+struct Record {
+  uint64_t _calls = 0;
+  uint64_t _bytes = 0;
+  uint64_t _ns = 0;
+  uint64_t _waits = 0;
+  uint64_t _waitNs = 0;
+};
+
+using Key = std::pair<Collective, std::string>; // collective, call site
+
+static std::mutex mutex;
+static std::map<Key, Record> records;
+static std::vector<uint64_t> sent; // bytes sent to each rank
+static std::map<uint64_t, Key> pending; // handles of non-blocking calls
+
+static Key key(Collective c) { return {c, _site ? _site : "other"}; }
+
+void record(Collective c, uint64_t bytes, const uint64_t *toRank,
+            uint64_t ns) {
+  auto k = key(c);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &r = records[k];
+  ++r._calls;
+  r._bytes += bytes;
+  r._ns += ns;
+  if (toRank) {
+    auto tc = getTransceiver();
+    auto n = tc ? tc->nranks() : 1;
+    sent.resize(n, 0);
+    for (rank_type i = 0; i < n; ++i) {
+      sent[i] += toRank[i];
+    }
+  }
+}
+
+void issued(Collective c, uint64_t handle) {
+  auto k = key(c);
+  std::lock_guard<std::mutex> lock(mutex);
+  pending[handle] = std::move(k);
+}
+
+void waited(uint64_t handle, uint64_t ns) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto p = pending.find(handle);
+  if (p == pending.end()) {
+    return;
+  }
+  auto &r = records[p->second];
+  ++r._waits;
+  r._waitNs += ns;
+  pending.erase(p);
+}
+
+void write() {
+  if (!_enabled) {
+    return;
+  }
+  auto tc = getTransceiver();
+  auto rank = tc ? tc->rank() : 0;
+  auto nranks = tc ? tc->nranks() : 1;
+  auto fname = prefix + "." + std::to_string(rank) + ".json";
+  std::ofstream os(fname);
+  if (!os) {
+    std::cerr << "sharpy: cannot write communication stats " << fname
+              << std::endl;
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  sent.resize(nranks, 0);
+  os << "{\"rank\":" << rank << ",\"nranks\":" << nranks
+     << ",\n\"collectives\":[";
+  bool first = true;
+  for (auto &[k, r] : records) {
+    os << (first ? "\n" : ",\n") << "  {\"collective\":\"" << name(k.first)
+       << "\",\"site\":\"" << k.second << "\",\"calls\":" << r._calls
+       << ",\"bytes\":" << r._bytes << ",\"ns\":" << r._ns
+       << ",\"waits\":" << r._waits << ",\"wait_ns\":" << r._waitNs << "}";
+    first = false;
+  }
+  os << "\n],\n\"sent\":[";
+  for (rank_type i = 0; i < nranks; ++i) {
+    os << (i ? "," : "") << sent[i];
+  }
+  os << "]}\n";
+}
+
+} // namespace comm
+} // namespace SHARPY
@@ -114,9 +114,14 @@ struct DeferredFull : public Deferred {
 FutureArray *Creator::full(const shape_type &shape, const py::object &val,
                            DTypeId dtype, const std::string &device,
                            uint64_t team) {
-  auto v = mk_scalar(val, dtype);
+  return full(shape, mk_scalar(val, dtype), dtype, device, team);
+}
+
+FutureArray *Creator::full(const shape_type &shape, PyScalar val,
+                           DTypeId dtype, const std::string &device,
+                           uint64_t team) {
   return new FutureArray(
-      defer<DeferredFull>(shape, v, dtype, device, mkTeam(team)));
+      defer<DeferredFull>(shape, val, dtype, device, mkTeam(team)));
 }
 
 // ***************************************************************************
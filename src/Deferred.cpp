@@ -8,9 +8,11 @@
 */
 
 #include "include/sharpy/Deferred.hpp"
+#include "include/sharpy/FlushStats.hpp"
 #include "include/sharpy/Mediator.hpp"
 #include "include/sharpy/Registry.hpp"
 #include "include/sharpy/Service.hpp"
+#include "include/sharpy/Trace.hpp"
 #include "include/sharpy/Transceiver.hpp"
 #include "include/sharpy/itac.hpp"
 #include "include/sharpy/jit/mlir.hpp"
@@ -72,6 +74,46 @@ void Runable::defer(Runable::ptr_type &&p) { push_runable(std::move(p)); }
 
 void Runable::fini() { _deferred.clear(); }
 
+const char *Runable::flush_cause() const {
+  switch (factory()) {
+  case F_GATHER:
+  case F_GATHERCHUNKS:
+    return "to_numpy";
+  case F_GETITEM:
+    return "getitem";
+  case F_GETLOCALS:
+    return "get_locals";
+  case F_ITEM:
+  case F_REPLICATE:
+    return "scalar";
+  case F_ITEMSET:
+  case F_SETITEM:
+  case F_SETITEMNUMPY:
+    return "setitem";
+  case F_MAP:
+    return "map";
+  case F_SAVE:
+  case F_LOAD:
+  case F_TODLPACK:
+  case F_FROMLOCALS:
+    return "io";
+  default:
+    return "other";
+  }
+}
+
+// location of r's ops in the generated MLIR: its Python caller if known
+static ::mlir::Location srcLoc(const Runable &r, ::mlir::OpBuilder &builder,
+                               const ::mlir::Location &loc) {
+  if (!r._srcLoc || !use_src_locs()) {
+    return loc;
+  }
+  auto &s = *r._srcLoc;
+  return ::mlir::NameLoc::get(
+      builder.getStringAttr(s._func),
+      ::mlir::FileLineColLoc::get(builder.getContext(), s._file, s._line, 0));
+}
+
 // process promises as they arrive through calls to defer
 // This is run in a separate thread until shutdown is requested.
 // Shutdown is indicated by a Deferred object which evaluates to false.
@@ -88,6 +130,7 @@ void process_promises(const std::string &libidtr) {
   VT(VT_funcdef, "pop", vtSHARPYClass, &vtPopSym);
   VT(VT_begin, vtProcessSym);
 
+  trace::set_thread_name("worker");
   bool done = false;
   jit::JIT jit(libidtr);
   std::vector<Runable::ptr_type> deleters;
@@ -103,8 +146,10 @@ void process_promises(const std::string &libidtr) {
     Runable::ptr_type d;
 
     if (!deleters.empty()) {
+      // deleting arrays is never part of a recorded function
+      dm.skipRecording();
       for (auto &dl : deleters) {
-        if (dl->generate_mlir(builder, loc, dm)) {
+        if (dl->generate_mlir(builder, srcLoc(*dl, builder, loc), dm)) {
           assert(!"deleters must generate MLIR");
         }
         runables.emplace_back(std::move(dl));
@@ -119,9 +164,14 @@ void process_promises(const std::string &libidtr) {
           if (d->isDeleter()) {
             deleters.emplace_back(std::move(d));
           } else {
-            if (d->generate_mlir(builder, loc, dm)) {
+            auto begin = trace::enabled() ? trace::now() : 0;
+            auto run = d->generate_mlir(builder, srcLoc(*d, builder, loc), dm);
+            if (begin) {
+              trace::complete("build_mlir", "jit", begin);
+            }
+            if (run) {
               break;
-            };
+            }
             // keep alive for later set_value
             runables.emplace_back(std::move(d));
           }
@@ -134,11 +184,23 @@ void process_promises(const std::string &libidtr) {
     }
 
     if (!runables.empty()) {
+      if (!runables.front()->isDeleter()) {
+        // the op requesting execution (or shutdown) ended the function
+        auto cause = d ? d->flush_cause() : "fini";
+        trace::instant(cause, "flush");
+        flushes::record(cause, d ? d->_srcLoc.get() : nullptr,
+                        runables.size(), dm.numOps());
+      }
+      TRACE_SCOPE("flush", "jit");
       dm.finalizeAndRun();
     } // no else needed
 
     // now we execute the deferred action which could not be compiled
     if (d) {
+      if (auto rec = jit::DepManager::recording()) {
+        ++rec->_nRuns;
+      }
+      TRACE_SCOPE("run", "deferred");
       py::gil_scoped_acquire acquire;
       d->run();
       d.reset();
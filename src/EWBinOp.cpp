@@ -183,24 +183,26 @@ FutureArray *EWBinOp::op(EWBinOpId op, const py::object &a,
   }
   auto aa = Creator::mk_future(a, devb, teamb, dtypeb);
   auto bb = Creator::mk_future(b, deva, teama, dtypea);
-  if (bb.first->get().device() != aa.first->get().device()) {
+  // temporaries for scalar operands
+  std::unique_ptr<FutureArray> ta(aa.second ? aa.first : nullptr);
+  std::unique_ptr<FutureArray> tb(bb.second ? bb.first : nullptr);
+  return EWBinOp::op(op, *aa.first, *bb.first);
+}
+
+FutureArray *EWBinOp::op(EWBinOpId op, const FutureArray &a,
+                         const FutureArray &b) {
+  if (b.get().device() != a.get().device()) {
     throw std::runtime_error(
         "devices of operands do not match in binary operation");
   }
-  if (bb.first->get().team() != aa.first->get().team()) {
+  if (b.get().team() != a.get().team()) {
     throw std::runtime_error(
         "teams of operands do not match in binary operation");
   }
   if (op == __MATMUL__) {
-    return LinAlgOp::vecdot(*aa.first, *bb.first, 0);
+    return LinAlgOp::vecdot(a, b, 0);
   }
-  auto res = new FutureArray(
-      defer<DeferredEWBinOp>(op, aa.first->get(), bb.first->get()));
-  if (aa.second)
-    delete aa.first;
-  if (bb.second)
-    delete bb.first;
-  return res;
+  return new FutureArray(defer<DeferredEWBinOp>(op, a.get(), b.get()));
 }
 
 FACTORY_INIT(DeferredEWBinOp, F_EWBINOP);
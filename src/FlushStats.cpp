@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Flush statistics (see FlushStats.hpp).
+  Recorded by the worker thread, read by the Python thread.
+*/
+
+#include "sharpy/FlushStats.hpp"
+#include "sharpy/Deferred.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <iostream>
+#include <mutex>
+
+namespace SHARPY {
+namespace flushes {
+
+static const int warnAt = get_int_env("SHARPY_FLUSH_WARN", 0);
+
+static std::mutex mutex;
+static Counts totals;
+static std::map<std::string, Counts> causes;
+static std::map<std::string, Site> sites;
+
+bool capture_sites() { return warnAt > 0 || use_src_locs(); }
+
+static void add(Counts &c, uint64_t nOps, uint64_t kernelOps) {
+  ++c._flushes;
+  c._ops += nOps;
+  c._kernelOps += kernelOps;
+}
+
+void record(const char *cause, const SrcLoc *loc, uint64_t nOps,
+            uint64_t kernelOps) {
+  std::lock_guard<std::mutex> lock(mutex);
+  add(totals, nOps, kernelOps);
+  add(causes[cause], nOps, kernelOps);
+  if (!loc) {
+    return;
+  }
+
+  auto key = loc->_file + ":" + std::to_string(loc->_line);
+  auto &site = sites[key];
+  site._func = loc->_func;
+  site._cause = cause;
+  add(site._counts, nOps, kernelOps);
+  if (warnAt > 0 && site._counts._flushes == static_cast<uint64_t>(warnAt)) {
+    std::cerr << "sharpy: " << key << " (" << loc->_func << ") caused "
+              << warnAt << " flushes (" << cause << ", "
+              << site._counts._ops / warnAt
+              << " ops per flush). Reading values in a loop prevents fusing "
+                 "the loop's operations."
+              << std::endl;
+  }
+}
+
+Counts total() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return totals;
+}
+
+std::map<std::string, Counts> by_cause() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return causes;
+}
+
+std::map<std::string, Site> by_site() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return sites;
+}
+
+void reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  totals = {};
+  causes.clear();
+  sites.clear();
+}
+
+} // namespace flushes
+} // namespace SHARPY
@@ -5,74 +5,786 @@
 */
 
 #include "sharpy/IO.hpp"
+#include "sharpy/CollComm.hpp"
+#include "sharpy/CommStats.hpp"
+#include "sharpy/DLPack.hpp"
 #include "sharpy/Factory.hpp"
 #include "sharpy/NDArray.hpp"
 #include "sharpy/PyTypes.hpp"
+#include "sharpy/Service.hpp"
 #include "sharpy/SetGetItem.hpp"
 #include "sharpy/Transceiver.hpp"
 #include "sharpy/TypeDispatch.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <oneapi/tbb/task_arena.h>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
 
 namespace SHARPY {
 
 // ***************************************************************************
 
-/// @brief form a FutureArray from local numpy arrays (inplace - no copy)
+/// @brief A local buffer to be wrapped (no copy) as the data of an array.
+/// The owner keeps the memory alive for as long as the array needs it.
+struct LocalBuffer {
+  DTypeId _dtype;
+  std::vector<ssize_t> _shape;
+  std::vector<intptr_t> _strides; // in number of elements
+  void *_data;
+  std::unique_ptr<BaseObj> _owner;
+};
+
+// get our DTypeId from py::dtype
+static DTypeId getDTypeId(const py::dtype &dtype) {
+  auto bw = dtype.itemsize();
+  auto kind = dtype.kind();
+  switch (kind) {
+  case 'i':
+    switch (bw) {
+    case 1:
+      return INT8;
+    case 2:
+      return INT16;
+    case 4:
+      return INT32;
+    case 8:
+      return INT64;
+    };
+    break;
+  case 'u':
+    switch (bw) {
+    case 1:
+      return UINT8;
+    case 2:
+      return UINT16;
+    case 4:
+      return UINT32;
+    case 8:
+      return UINT64;
+    };
+    break;
+  case 'f':
+    switch (bw) {
+    case 4:
+      return FLOAT32;
+    case 8:
+      return FLOAT64;
+    };
+    break;
+  case 'b':
+    return BOOL;
+  };
+  throw std::invalid_argument("Unsupported dtype");
+}
+
+static LocalBuffer mk_local_buffer(py::array npa) {
+  auto eSz = npa.itemsize();
+  // py::array stores strides in bytes, not elements
+  std::vector<intptr_t> strides(npa.ndim());
+  for (auto i = 0; i < npa.ndim(); ++i) {
+    strides[i] = npa.strides()[i] / eSz;
+  }
+  auto data = npa.mutable_data();
+  return {getDTypeId(npa.dtype()),
+          {npa.shape(), npa.shape() + npa.ndim()},
+          std::move(strides),
+          data,
+          // make sure we do not delete numpy's memory before the numpy array
+          // is dead (notice: py::objects have ref-counting)
+          std::make_unique<SharedBaseObject<py::object>>(std::move(npa))};
+}
+
+/// @brief form a FutureArray from a local buffer (inplace - no copy)
+/// If distributed, the buffer is the block of the global array starting at
+/// _lOffs; halos are empty.
 struct DeferredFromLocal : public Deferred {
-  py::array _npa;
+  LocalBuffer _buff;
+  std::vector<int64_t> _lOffs;
 
   DeferredFromLocal() = default;
-  DeferredFromLocal(py::array npa)
-      : Deferred(getDTypeId(npa.dtype()),
-                 {npa.shape(), npa.shape() + npa.ndim()}, {}, 0),
-        _npa(npa) {}
-
-  // get our DTypeId from py::dtype
-  DTypeId getDTypeId(const py::dtype &dtype) {
-    auto bw = dtype.itemsize();
-    auto kind = dtype.kind();
-    switch (kind) {
-    case 'i':
-      switch (bw) {
-      case 1:
+  DeferredFromLocal(LocalBuffer &&buff)
+      : Deferred(buff._dtype, {buff._shape.begin(), buff._shape.end()}, {}, 0),
+        _buff(std::move(buff)) {}
+  DeferredFromLocal(LocalBuffer &&buff, shape_type &&gShape,
+                    std::vector<int64_t> &&lOffs)
+      : Deferred(buff._dtype, std::move(gShape), {}, 1),
+        _buff(std::move(buff)), _lOffs(std::move(lOffs)) {}
+
+  void run() override {
+    auto nd = _buff._shape.size();
+    NDArray::ptr_type res;
+    if (this->team() == 0) {
+      res = mk_tnsr(this->guid(), _buff._dtype, nd, _buff._shape.data(),
+                    _buff._strides.data(), _buff._data, this->device(),
+                    this->team());
+    } else {
+      // halos have no rows but must point to valid memory
+      static int64_t dummy = 0;
+      void *data = _buff._data ? _buff._data : &dummy;
+      std::vector<intptr_t> hShape(_buff._shape.begin(), _buff._shape.end());
+      hShape.front() = 0;
+      const intptr_t *shape = _buff._shape.data();
+      const intptr_t *strides = _buff._strides.data();
+      res = mk_tnsr(this->guid(), _buff._dtype, this->shape(), this->device(),
+                    this->team(), data, data, 0, hShape.data(), strides, data,
+                    data, 0, shape, strides, data, data, 0, hShape.data(),
+                    strides, std::move(_lOffs));
+    }
+    res->set_base(_buff._owner.release());
+    set_value(std::move(res));
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_FROMLOCALS; }
+
+  template <typename S> void serialize(S &ser) {}
+};
+
+static bool FORCE_DIST = get_bool_env("SHARPY_FORCE_DIST");
+
+/// @brief form distributed arrays from local blocks of irregular size
+/// Local blocks are stacked along the first axis in rank order. Metadata of
+/// all arrays is exchanged in a single allgather, all processes must pass
+/// the same number of arrays.
+static std::vector<FutureArray *>
+from_local_buffers(std::vector<LocalBuffer> &&buffs) {
+  auto trscvr = getTransceiver();
+  if (trscvr->is_cw()) {
+    throw std::runtime_error("from_locals is not supported in c/w mode.");
+  }
+  std::vector<FutureArray *> res;
+  if (!FORCE_DIST && trscvr->nranks() == 1) {
+    for (auto &b : buffs) {
+      res.emplace_back(new FutureArray(defer<DeferredFromLocal>(std::move(b))));
+    }
+    return res;
+  }
+
+  // per array: dtype, ndims, number of rows and a hash of the trailing
+  // dimensions; fixed size so that one allgather suffices
+  constexpr size_t META_SZ = 4;
+  std::vector<int64_t> meta;
+  for (auto &b : buffs) {
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (size_t d = 1; d < b._shape.size(); ++d) {
+      h = (h ^ static_cast<uint64_t>(b._shape[d])) * 1099511628211ull;
+    }
+    meta.emplace_back(b._dtype);
+    meta.emplace_back(b._shape.size());
+    meta.emplace_back(b._shape.empty() ? 0 : b._shape.front());
+    meta.emplace_back(static_cast<int64_t>(h));
+  }
+
+  // the exchange must run in the worker thread, we wait for it here
+  auto promise = std::make_shared<std::promise<std::vector<int64_t>>>();
+  auto fut = promise->get_future();
+  defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+               [promise, meta]() {
+                 try {
+                   COMM_SITE("io");
+                   auto trscvr = getTransceiver();
+                   auto nr = trscvr->nranks();
+                   int sz = static_cast<int>(meta.size());
+                   std::vector<int> counts(nr, sz);
+                   std::vector<int> displacements(nr);
+                   for (rank_type r = 0; r < nr; ++r) {
+                     displacements[r] = static_cast<int>(r) * sz;
+                   }
+                   std::vector<int64_t> all(nr * sz);
+                   std::copy(meta.begin(), meta.end(),
+                             all.begin() + trscvr->rank() * sz);
+                   trscvr->gather(all.data(), counts.data(),
+                                  displacements.data(), INT64, REPLICATED);
+                   promise->set_value(std::move(all));
+                 } catch (...) {
+                   promise->set_exception(std::current_exception());
+                 }
+               });
+  std::vector<int64_t> all;
+  {
+    py::gil_scoped_release release;
+    Service::run();
+    all = fut.get();
+  }
+
+  auto nr = trscvr->nranks();
+  auto myrank = trscvr->rank();
+  auto sz = meta.size();
+  size_t pos = 0;
+  for (auto &b : buffs) {
+    auto nd = b._shape.size();
+    if (nd == 0) {
+      throw std::invalid_argument("from_locals: cannot distribute 0d arrays");
+    }
+    shape_type gShape(b._shape.begin(), b._shape.end());
+    gShape.front() = 0;
+    std::vector<int64_t> lOffs(nd, 0);
+    for (rank_type r = 0; r < nr; ++r) {
+      auto rmeta = all.data() + r * sz + pos;
+      if (rmeta[0] != meta[pos] || rmeta[1] != meta[pos + 1] ||
+          rmeta[3] != meta[pos + 3]) {
+        throw std::invalid_argument("from_locals: local arrays must have "
+                                    "equal dtype and trailing dimensions");
+      }
+      if (r == myrank) {
+        lOffs.front() = gShape.front();
+      }
+      gShape.front() += rmeta[2];
+    }
+    pos += META_SZ;
+    res.emplace_back(new FutureArray(defer<DeferredFromLocal>(
+        std::move(b), std::move(gShape), std::move(lOffs))));
+  }
+  return res;
+}
+
+// ***************************************************************************
+// DLPack
+
+using namespace dlpack;
+
+static DLDataType to_dlpack(DTypeId dtype) {
+  uint8_t bits = sizeof_dtype(dtype) * 8;
+  switch (dtype) {
+  case FLOAT64:
+  case FLOAT32:
+    return {kDLFloat, bits, 1};
+  case INT64:
+  case INT32:
+  case INT16:
+  case INT8:
+    return {kDLInt, bits, 1};
+  case UINT64:
+  case UINT32:
+  case UINT16:
+  case UINT8:
+    return {kDLUInt, bits, 1};
+  case BOOL:
+    return {kDLBool, bits, 1};
+  default:
+    throw std::invalid_argument("Unsupported dtype for DLPack");
+  }
+}
+
+static DTypeId from_dlpack(const DLDataType &dt) {
+  if (dt.lanes == 1) {
+    switch (dt.code) {
+    case kDLFloat:
+      switch (dt.bits) {
+      case 32:
+        return FLOAT32;
+      case 64:
+        return FLOAT64;
+      }
+      break;
+    case kDLInt:
+      switch (dt.bits) {
+      case 8:
         return INT8;
-      case 2:
+      case 16:
         return INT16;
-      case 4:
+      case 32:
         return INT32;
-      case 8:
+      case 64:
         return INT64;
-      };
-    case 'f':
-      switch (bw) {
-      case 4:
-        return FLOAT32;
+      }
+      break;
+    case kDLUInt:
+      switch (dt.bits) {
       case 8:
-        return FLOAT64;
-      };
+        return UINT8;
+      case 16:
+        return UINT16;
+      case 32:
+        return UINT32;
+      case 64:
+        return UINT64;
+      }
+      break;
+    case kDLBool:
+      if (dt.bits == 8)
+        return BOOL;
+      break;
+    }
+  }
+  throw std::invalid_argument("Unsupported DLPack dtype");
+}
+
+static bool is_host_device(const std::string &device) {
+  return device.empty() || device.find("gpu") == std::string::npos;
+}
+
+/// @brief keeps the exported NDArray alive until the consumer is done
+struct DLPackExport {
+  NDArray::ptr_type _a;
+  std::vector<int64_t> _shape;
+  std::vector<int64_t> _strides;
+  DLManagedTensor _mt;
+};
+
+/// @brief returns a foreign DLPack tensor to its producer when our array dies
+struct DLPackOwner : public BaseObj {
+  DLManagedTensor *_mt;
+  DLPackOwner(DLManagedTensor *mt) : _mt(mt) {}
+  ~DLPackOwner() {
+    if (_mt->deleter) {
+      _mt->deleter(_mt);
+    }
+  }
+  // producers are usually Python libraries
+  bool needGIL() const override { return true; }
+};
+
+// an unconsumed capsule owns the DLManagedTensor
+static void dlpack_capsule_deleter(PyObject *capsule) {
+  if (PyCapsule_IsValid(capsule, USED_CAPSULE_NAME)) {
+    return;
+  }
+  auto mt = static_cast<DLManagedTensor *>(
+      PyCapsule_GetPointer(capsule, CAPSULE_NAME));
+  if (mt == nullptr) {
+    PyErr_WriteUnraisable(capsule);
+    return;
+  }
+  if (mt->deleter) {
+    mt->deleter(mt);
+  }
+}
+
+/// @brief export local partition as a DLPack capsule (no copy)
+struct DeferredToDLPack
+    : public DeferredT<GetItem::py_promise_type, GetItem::py_future_type> {
+  id_type _a;
+
+  DeferredToDLPack() = default;
+  DeferredToDLPack(const array_i::future_type &a) : _a(a.guid()) {}
+
+  void run() override {
+    auto a_ptr = std::dynamic_pointer_cast<NDArray>(Registry::get(_a).get());
+    if (!a_ptr) {
+      throw std::invalid_argument("Expected NDArray in __dlpack__.");
+    }
+    auto nd = a_ptr->ndims();
+    auto ctx = new DLPackExport{a_ptr,
+                                {a_ptr->local_shape(),
+                                 a_ptr->local_shape() + nd},
+                                {a_ptr->local_strides(),
+                                 a_ptr->local_strides() + nd},
+                                {}};
+    auto &t = ctx->_mt.dl_tensor;
+    t.data = a_ptr->data();
+    t.device = {kDLCPU, 0};
+    t.ndim = nd;
+    t.dtype = to_dlpack(a_ptr->dtype());
+    t.shape = ctx->_shape.data();
+    t.strides = ctx->_strides.data();
+    t.byte_offset = 0;
+    ctx->_mt.manager_ctx = ctx;
+    ctx->_mt.deleter = [](DLManagedTensor *self) {
+      delete static_cast<DLPackExport *>(self->manager_ctx);
     };
-    throw std::invalid_argument("Unsupported dtype");
+    auto capsule = PyCapsule_New(&ctx->_mt, CAPSULE_NAME,
+                                 dlpack_capsule_deleter);
+    if (!capsule) {
+      delete ctx;
+      throw py::error_already_set();
+    }
+    set_value(capsule);
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_TODLPACK; }
+
+  template <typename S> void serialize(S &ser) {
+    ser.template value<sizeof(_a)>(_a);
+  }
+};
+
+GetItem::py_future_type IO::to_dlpack(const FutureArray &a) {
+  auto afut = a.get();
+  if (!is_host_device(afut.device())) {
+    throw std::runtime_error("DLPack export is only supported for CPU arrays");
+  }
+  return defer<DeferredToDLPack>(afut);
+}
+
+py::tuple IO::dlpack_device(const FutureArray &a) {
+  if (!is_host_device(a.get().device())) {
+    throw std::runtime_error("DLPack export is only supported for CPU arrays");
+  }
+  return py::make_tuple(static_cast<int>(kDLCPU), 0);
+}
+
+FutureArray *IO::from_dlpack(const py::capsule &capsule) {
+  if (!PyCapsule_IsValid(capsule.ptr(), CAPSULE_NAME)) {
+    throw std::invalid_argument("Expected an unconsumed DLPack capsule");
+  }
+  auto mt = static_cast<DLManagedTensor *>(
+      PyCapsule_GetPointer(capsule.ptr(), CAPSULE_NAME));
+  const auto &t = mt->dl_tensor;
+  if (t.device.device_type != kDLCPU &&
+      t.device.device_type != kDLCUDAHost) {
+    throw std::invalid_argument("from_dlpack only supports CPU tensors");
+  }
+  auto dtype = from_dlpack(t.dtype);
+  std::vector<intptr_t> strides(t.ndim);
+  for (auto i = t.ndim - 1; i >= 0; --i) {
+    // no strides means compact row-major
+    strides[i] = t.strides                ? t.strides[i]
+                 : i == t.ndim - 1        ? 1
+                                          : strides[i + 1] * t.shape[i + 1];
+  }
+  LocalBuffer buff{dtype,
+                   {t.shape, t.shape + t.ndim},
+                   std::move(strides),
+                   static_cast<char *>(t.data) + t.byte_offset,
+                   std::make_unique<DLPackOwner>(mt)};
+  // we own it now
+  PyCapsule_SetName(capsule.ptr(), USED_CAPSULE_NAME);
+  // the local tensor becomes this process' partition
+  std::vector<LocalBuffer> buffs;
+  buffs.emplace_back(std::move(buff));
+  return from_local_buffers(std::move(buffs)).front();
+}
+
+// ***************************************************************************
+// Checkpoints
+//
+// Every process appends the local partitions of all arrays to its own part
+// file. A partition is stored as a sequence of blocks of at most blockRows
+// rows (first dimension). Each block is preceded by its size in bytes as a
+// uint64 (the compressed size if compressed with zlib). Replicated and
+// non-distributed arrays are written by process 0 only.
+// Process 0 collects where each partition went and hands it to a callback
+// which writes the manifest.
+
+// target number of (uncompressed) bytes per block
+static constexpr int64_t CKPT_BLOCK_BYTES = 1 << 22;
+
+static std::string part_file(const std::string &path, uint64_t rank) {
+  char fname[32];
+  snprintf(fname, sizeof(fname), "part-%05" PRIu64 ".bin", rank);
+  return path + "/" + fname;
+}
+
+// @return number of bytes of one row (slice in first dimension)
+static int64_t row_size(const NDArray::ptr_type &a_ptr) {
+  const auto &shp = a_ptr->shape();
+  return std::accumulate(shp.begin() + (shp.empty() ? 0 : 1), shp.end(),
+                         static_cast<int64_t>(sizeof_dtype(a_ptr->dtype())),
+                         std::multiplies<int64_t>());
+}
+
+// @return first global row and number of rows this process stores/loads
+static std::pair<int64_t, int64_t> my_rows(const NDArray::ptr_type &a_ptr,
+                                           bool writing) {
+  auto trscvr = a_ptr->transceiver();
+  if (a_ptr->ndims() > 0 && trscvr && trscvr->nranks() > 1 &&
+      !a_ptr->is_replicated()) {
+    return {a_ptr->local_offsets()[0], a_ptr->local_shape()[0]};
+  }
+  // replicated: process 0 writes everything, all processes read everything
+  int64_t n = a_ptr->ndims() ? a_ptr->shape()[0] : 1;
+  return {0, writing && getTransceiver()->rank() != 0 ? 0 : n};
+}
+
+static void pread_all(int fd, char *buff, size_t n, int64_t off) {
+  while (n > 0) {
+    auto r = pread(fd, buff, n, off);
+    if (r <= 0) {
+      throw std::runtime_error("Reading checkpoint failed.");
+    }
+    buff += r;
+    off += r;
+    n -= r;
+  }
+}
+
+/// @brief Describes where a partition is stored in a file
+/// and how it is stored.
+struct StoredPart {
+  uint64_t _file;   // rank which wrote it
+  int64_t _rowOff;  // first global row
+  int64_t _nRows;   // number of rows
+  int64_t _fileOff; // byte offset in file
+};
+
+struct StoreLayout {
+  int64_t _rowSz;     // bytes per row
+  int64_t _blockRows; // rows per block
+  bool _headers;      // blocks are preceded by their size
+  bool _compressed;   // blocks are zlib-compressed
+  bool _partFiles;    // one file per writing process, otherwise single file
+};
+
+// read rows [start, end) (relative to part) of given part into buff
+static void read_rows(int fd, const StoredPart &part, const StoreLayout &lyt,
+                      int64_t start, int64_t end, char *buff) {
+  auto hdr = lyt._headers ? static_cast<int64_t>(sizeof(uint64_t)) : 0;
+  if (!lyt._compressed) {
+    // we can compute where the rows are
+    auto blockBytes = hdr + lyt._blockRows * lyt._rowSz;
+    for (auto r = start; r < end;) {
+      auto b = r / lyt._blockRows;
+      auto n = std::min(end, (b + 1) * lyt._blockRows) - r;
+      pread_all(fd, buff, n * lyt._rowSz,
+                part._fileOff + b * blockBytes + hdr +
+                    (r - b * lyt._blockRows) * lyt._rowSz);
+      buff += n * lyt._rowSz;
+      r += n;
+    }
+    return;
+  }
+
+  // compressed: walk the block headers
+  std::vector<char> cbuff, raw;
+  auto off = part._fileOff;
+  for (int64_t bs = 0; bs < end; bs += lyt._blockRows) {
+    uint64_t sz;
+    pread_all(fd, reinterpret_cast<char *>(&sz), sizeof(sz), off);
+    auto be = std::min(bs + lyt._blockRows, part._nRows);
+    if (be > start) {
+      cbuff.resize(sz);
+      raw.resize((be - bs) * lyt._rowSz);
+      pread_all(fd, cbuff.data(), sz, off + hdr);
+      uLongf rawSz = raw.size();
+      if (uncompress(reinterpret_cast<Bytef *>(raw.data()), &rawSz,
+                     reinterpret_cast<const Bytef *>(cbuff.data()),
+                     sz) != Z_OK ||
+          rawSz != raw.size()) {
+        throw std::runtime_error("Corrupt checkpoint block.");
+      }
+      auto lo = std::max(start, bs);
+      auto hi = std::min(end, be);
+      memcpy(buff, raw.data() + (lo - bs) * lyt._rowSz,
+             (hi - lo) * lyt._rowSz);
+      buff += (hi - lo) * lyt._rowSz;
+    }
+    off += hdr + sz;
+  }
+}
+
+// fill local rows of a_ptr from given parts
+static void load_rows(const NDArray::ptr_type &a_ptr, const std::string &path,
+                      const std::vector<StoredPart> &parts,
+                      const StoreLayout &lyt) {
+  auto [myOff, myRows] = my_rows(a_ptr, false);
+  std::vector<char> buff;
+  for (auto &part : parts) {
+    auto lo = std::max(myOff, part._rowOff);
+    auto hi = std::min(myOff + myRows, part._rowOff + part._nRows);
+    if (lo >= hi)
+      continue;
+    buff.resize((hi - lo) * lyt._rowSz);
+    auto fname = lyt._partFiles ? part_file(path, part._file) : path;
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open file " + fname);
+    }
+    try {
+      read_rows(fd, part, lyt, lo - part._rowOff, hi - part._rowOff,
+                buff.data());
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    close(fd);
+    unbufferize_rows(a_ptr, lo - myOff, hi - myOff, buff.data());
+  }
+}
+
+/// @brief private copy of the local partition of an array to be saved
+struct SavedArray {
+  DTypeId _dtype;
+  shape_type _shape;
+  int64_t _rowSz, _blockRows, _rowOff, _nRows;
+  int64_t _fileOff = 0; // set when written
+  std::vector<char> _data;
+};
+
+/// @brief what a process writes to its part file
+struct SaveJob {
+  std::string _path;
+  bool _compress;
+  std::vector<SavedArray> _arrays;
+  std::string _error; // errors must not stop us from joining collectives
+};
+
+// copy local partitions of arrays so that they can be written while
+// computation continues.
+// Errors go to job._error. All processes must run the same collectives in
+// finish_save, so a failed array still gets an (empty) entry.
+static void snapshot(SaveJob &job, const std::vector<id_type> &ids) {
+  for (auto id : ids) {
+    auto &sa = job._arrays.emplace_back();
+    try {
+      auto a_ptr = std::dynamic_pointer_cast<NDArray>(Registry::get(id).get());
+      if (!a_ptr) {
+        throw std::invalid_argument("Expected NDArray in save.");
+      }
+      auto rowSz = row_size(a_ptr);
+      auto [myOff, myRows] = my_rows(a_ptr, true);
+      sa = SavedArray{a_ptr->dtype(), a_ptr->shape(), rowSz,
+                      std::max<int64_t>(1, CKPT_BLOCK_BYTES / rowSz), myOff,
+                      myRows};
+      sa._data.resize(myRows * rowSz);
+      if (myRows == 0) {
+        continue;
+      } else if (a_ptr->ndims() == 0) {
+        bufferize(a_ptr, sa._data.data());
+      } else {
+        bufferize_rows(a_ptr, 0, myRows, sa._data.data());
+      }
+    } catch (std::exception &e) {
+      if (job._error.empty()) {
+        job._error = e.what();
+      }
+      sa._nRows = 0;
+      std::vector<char>().swap(sa._data);
+    }
+  }
+}
+
+// write (and compress) snapshot to part file; no communication involved
+static void write_part(SaveJob &job, rank_type rank) {
+  auto fname = part_file(job._path, rank);
+  FILE *f = fopen(fname.c_str(), "wb");
+  if (!f) {
+    job._error = "Cannot open " + fname + " for writing.";
+    return;
+  }
+
+  std::vector<char> cbuff;
+  for (auto &sa : job._arrays) {
+    sa._fileOff = ftell(f);
+    for (int64_t r = 0; r < sa._nRows; r += sa._blockRows) {
+      auto n = std::min(sa._blockRows, sa._nRows - r);
+      const char *out = sa._data.data() + r * sa._rowSz;
+      uint64_t sz = n * sa._rowSz;
+      if (job._compress) {
+        uLongf csz = compressBound(sz);
+        cbuff.resize(csz);
+        if (compress2(reinterpret_cast<Bytef *>(cbuff.data()), &csz,
+                      reinterpret_cast<const Bytef *>(out), sz,
+                      Z_DEFAULT_COMPRESSION) != Z_OK) {
+          job._error = "Compression failed.";
+          fclose(f);
+          return;
+        }
+        out = cbuff.data();
+        sz = csz;
+      }
+      if (fwrite(&sz, sizeof(sz), 1, f) != 1 || fwrite(out, 1, sz, f) != sz) {
+        job._error = "Writing " + fname + " failed.";
+        fclose(f);
+        return;
+      }
+    }
+    // the snapshot is no longer needed
+    std::vector<char>().swap(sa._data);
+  }
+  if (fclose(f) != 0) {
+    job._error = "Writing " + fname + " failed.";
+  }
+}
+
+// process 0 collects where each process put its partitions and hands it to
+// the callback. Collective.
+// @return error message, empty on success
+static std::string finish_save(const SaveJob &job, py::object &callback) {
+  COMM_SITE("io");
+  auto trscvr = getTransceiver();
+  auto myrank = trscvr->rank();
+  auto nranks = trscvr->nranks();
+  auto error = job._error;
+
+  py::list meta;
+  std::vector<int64_t> info(3 * nranks);
+  std::vector<int> counts(nranks, 3);
+  std::vector<int> displacements(nranks);
+  for (auto i = 0ul; i < nranks; ++i) {
+    displacements[i] = 3 * i;
   }
+  for (auto &sa : job._arrays) {
+    info[3 * myrank + 0] = sa._rowOff;
+    info[3 * myrank + 1] = sa._nRows;
+    info[3 * myrank + 2] = sa._fileOff;
+    trscvr->gather(myrank ? &info[3 * myrank] : info.data(), counts.data(),
+                   displacements.data(), INT64, 0);
+
+    if (myrank == 0) {
+      py::list parts;
+      for (auto i = 0ul; i < nranks; ++i) {
+        if (info[3 * i + 1] > 0) {
+          parts.append(py::make_tuple(i, info[3 * i], info[3 * i + 1],
+                                      info[3 * i + 2]));
+        }
+      }
+      py::dict m;
+      m["dtype"] = py::cast(sa._dtype);
+      m["shape"] = py::cast(sa._shape);
+      m["block_rows"] = sa._blockRows;
+      m["parts"] = parts;
+      meta.append(m);
+    }
+  }
+
+  // a failed write anywhere invalidates the checkpoint
+  int64_t failed = error.empty() ? 0 : 1;
+  trscvr->reduce_all(&failed, INT64, 1, MAX);
+  if (myrank == 0 && failed == 0) {
+    try {
+      callback(nranks, meta);
+    } catch (py::error_already_set &e) {
+      error = e.what();
+    }
+  }
+  // nobody may read before the manifest is written
+  trscvr->barrier();
+  if (error.empty() && failed) {
+    error = "Checkpoint failed on another process.";
+  }
+  return error;
+}
+
+/// @brief write local partitions of arrays to the process' part file
+struct DeferredSave
+    : public DeferredT<GetItem::py_promise_type, GetItem::py_future_type> {
+  std::vector<id_type> _a;
+  std::string _path;
+  bool _compress;
+  py::object _callback;
+
+  DeferredSave() = default;
+  DeferredSave(std::vector<id_type> &&a, const std::string &path,
+               bool compress, py::object &callback)
+      : _a(std::move(a)), _path(path), _compress(compress),
+        _callback(callback) {}
 
   void run() override {
-    auto _strides = _npa.strides();
-    auto shape = _npa.shape();
-    auto data = _npa.mutable_data();
-    auto dtype = _npa.dtype();
-    auto ndim = _npa.ndim();
-    auto eSz = dtype.itemsize();
-
-    // py::array stores strides in bytes, not elements
-    std::vector<intptr_t> strides(ndim);
-    for (auto i = 0; i < ndim; ++i) {
-      strides[i] = _strides[i] / eSz;
-    }
-
-    auto res = mk_tnsr(this->guid(), getDTypeId(dtype), ndim, shape,
-                       strides.data(), data, this->device(), this->team());
-    // make sure we do not delete numpy's memory before the numpy array is dead
-    // notice: py::objects have ref-counting)
-    res->set_base(new SharedBaseObject<py::object>(_npa));
-    set_value(std::move(res));
+    SaveJob job{_path, _compress};
+    snapshot(job, _a);
+    write_part(job, getTransceiver()->rank());
+    auto error = finish_save(job, _callback);
+    if (error.empty()) {
+      set_value(py::none().release());
+    } else {
+      set_exception(std::make_exception_ptr(std::runtime_error(error)));
+    }
   }
 
   bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
@@ -80,25 +792,238 @@ struct DeferredFromLocal : public Deferred {
     return true;
   }
 
-  FactoryId factory() const override { return F_FROMLOCALS; }
+  FactoryId factory() const override { return F_SAVE; }
 
-  template <typename S> void serialize(S &ser) {}
+  template <typename S> void serialize(S &ser) {
+    throw std::runtime_error("Not implemented");
+  }
+};
+
+// background writers of async checkpoints
+static tbb::task_arena &ckpt_arena() {
+  static tbb::task_arena arena;
+  return arena;
+}
+
+/// @brief state of an asynchronous checkpoint shared between the handle,
+/// the snapshotting deferred op and the background writer
+struct AsyncSave::State {
+  SaveJob _job;
+  std::promise<void> _written;
+  std::shared_future<void> _fut = _written.get_future().share();
+};
+
+AsyncSave::AsyncSave(const std::vector<FutureArray *> &a,
+                     const std::string &path, bool compress)
+    : _state(std::make_shared<State>()) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("save is not supported in c/w mode");
+  }
+  Loop::check_sync();
+  std::vector<id_type> ids;
+  for (auto x : a) {
+    ids.emplace_back(x->get().guid());
+  }
+  _state->_job._path = path;
+  _state->_job._compress = compress;
+  // snapshot at this point of the deferred stream, write in the background
+  defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+               [state = _state, ids]() {
+                 snapshot(state->_job, ids);
+                 auto rank = getTransceiver()->rank();
+                 ckpt_arena().enqueue([state, rank]() {
+                   write_part(state->_job, rank);
+                   state->_written.set_value();
+                 });
+               });
+  // get the snapshot going without waiting for the next sync
+  Service::run();
+}
+
+bool AsyncSave::done() const {
+  return _state->_fut.wait_for(std::chrono::seconds(0)) ==
+         std::future_status::ready;
+}
+
+void AsyncSave::wait(py::object &callback) {
+  if (_finished) {
+    throw std::runtime_error("Checkpoint was already completed.");
+  }
+  _finished = true;
+  auto promise = std::make_shared<std::promise<std::string>>();
+  auto fut = promise->get_future();
+  defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+               [state = _state, callback, promise]() mutable {
+                 {
+                   py::gil_scoped_release release;
+                   state->_fut.wait();
+                 }
+                 promise->set_value(finish_save(state->_job, callback));
+               });
+  std::string error;
+  {
+    py::gil_scoped_release release;
+    Service::run();
+    error = fut.get();
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+}
+
+/// @brief fill a (freshly created) array with data from a checkpoint
+/// Each process reads exactly the rows of its local partition, from whatever
+/// part files hold them. The number of processes may differ from when the
+/// checkpoint was written.
+struct DeferredLoad : public Deferred {
+  id_type _a;
+  std::string _path; // directory or file if loading a single file
+  std::vector<StoredPart> _parts;
+  StoreLayout _layout;
+
+  DeferredLoad() = default;
+  DeferredLoad(const array_i::future_type &a, const std::string &path,
+               std::vector<StoredPart> &&parts, const StoreLayout &layout)
+      : Deferred(a.dtype(), a.shape(), a.device(), a.team(), a.guid()),
+        _a(a.guid()), _path(path), _parts(std::move(parts)), _layout(layout) {
+  }
+
+  void run() override {
+    auto aa = std::move(Registry::get(_a).get());
+    auto a_ptr = std::dynamic_pointer_cast<NDArray>(aa);
+    if (!a_ptr) {
+      throw std::invalid_argument("Expected NDArray in load.");
+    }
+    load_rows(a_ptr, _path, _parts, _layout);
+    this->set_value(aa);
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_LOAD; }
+
+  template <typename S> void serialize(S &ser) {
+    throw std::runtime_error("Not implemented");
+  }
 };
 
-GetItem::py_future_type IO::to_numpy(const FutureArray &a) {
-  if (getTransceiver()->is_cw() && getTransceiver()->rank() != 0) {
-    throw std::runtime_error(
-        "In c/w mode, to_numpy is only supported on rank 0");
+GetItem::py_future_type IO::save(const std::vector<FutureArray *> &a,
+                                 const std::string &path, bool compress,
+                                 py::object &callback) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("save is not supported in c/w mode");
+  }
+  std::vector<id_type> ids;
+  for (auto x : a) {
+    ids.emplace_back(x->get().guid());
+  }
+  return defer<DeferredSave>(std::move(ids), path, compress, callback);
+}
+
+void IO::load(FutureArray &a, const std::string &path,
+              const std::vector<std::vector<int64_t>> &parts,
+              int64_t blockRows, bool compressed) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("load is not supported in c/w mode");
+  }
+  auto afut = a.get();
+  std::vector<StoredPart> sParts;
+  for (auto &p : parts) {
+    if (p.size() != 4) {
+      throw std::invalid_argument("Invalid checkpoint partition");
+    }
+    sParts.push_back({static_cast<uint64_t>(p[0]), p[1], p[2], p[3]});
+  }
+  int64_t rowSz = std::accumulate(
+      afut.shape().begin() + (afut.shape().empty() ? 0 : 1),
+      afut.shape().end(), static_cast<int64_t>(sizeof_dtype(afut.dtype())),
+      std::multiplies<int64_t>());
+  a.put(defer<DeferredLoad>(afut, path, std::move(sParts),
+                            StoreLayout{rowSz, blockRows, true, compressed,
+                                        true}));
+}
+
+void IO::load_raw(FutureArray &a, const std::string &path, int64_t offset) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("load_raw is not supported in c/w mode");
+  }
+  auto afut = a.get();
+  const auto &shp = afut.shape();
+  int64_t nRows = shp.empty() ? 1 : shp.front();
+  int64_t rowSz = std::accumulate(
+      shp.begin() + (shp.empty() ? 0 : 1), shp.end(),
+      static_cast<int64_t>(sizeof_dtype(afut.dtype())),
+      std::multiplies<int64_t>());
+  // the file is a single contiguous part without block headers
+  std::vector<StoredPart> parts = {{0, 0, nRows, offset}};
+  a.put(defer<DeferredLoad>(
+      afut, path, std::move(parts),
+      StoreLayout{rowSz, std::max<int64_t>(nRows, 1), false, false, false}));
+}
+
+// ***************************************************************************
+
+// in c/w mode only the controller (rank 0) can receive data
+static rank_type check_root(rank_type root) {
+  if (getTransceiver()->is_cw()) {
+    if (getTransceiver()->rank() != 0) {
+      throw std::runtime_error(
+          "In c/w mode, to_numpy is only supported on rank 0");
+    }
+    if (root != 0 && root != REPLICATED) {
+      throw std::invalid_argument("In c/w mode, root must be 0");
+    }
+    return 0;
+  }
+  if (root != REPLICATED && root >= getTransceiver()->nranks()) {
+    throw std::invalid_argument("Invalid root rank");
+  }
+  return root;
+}
+
+GetItem::py_future_type IO::to_numpy(const FutureArray &a, rank_type root) {
+  return GetItem::gather(a, check_root(root));
+}
+
+GetItem::py_future_type IO::to_numpy_chunks(const FutureArray &a,
+                                            py::object &callback,
+                                            uint64_t chunkBytes,
+                                            rank_type root) {
+  if (chunkBytes == 0) {
+    throw std::invalid_argument("chunk size must be positive");
+  }
+  return GetItem::gather_chunks(a, callback, chunkBytes, check_root(root));
+}
+
+std::vector<FutureArray *> IO::from_locals(const std::vector<py::array> &a) {
+  std::vector<LocalBuffer> buffs;
+  for (auto &x : a) {
+    buffs.emplace_back(mk_local_buffer(x));
   }
-  return GetItem::gather(a, getTransceiver()->is_cw() ? 0 : REPLICATED);
+  return from_local_buffers(std::move(buffs));
 }
 
-FutureArray *IO::from_locals(const std::vector<py::array> &a) {
-  if (a.size() != 1) {
-    throw std::runtime_error("from_locals only supports a single local array");
+FutureArray *IO::from_local(DTypeId dtype, const shape_type &shape,
+                            void *data, std::unique_ptr<BaseObj> &&owner) {
+  auto nd = shape.size();
+  std::vector<intptr_t> strides(nd, 1);
+  for (int i = static_cast<int>(nd) - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * shape[i + 1];
   }
-  return new FutureArray(defer<DeferredFromLocal>(a.front()));
+  std::vector<LocalBuffer> buffs;
+  buffs.emplace_back(LocalBuffer{dtype,
+                                 {shape.begin(), shape.end()},
+                                 std::move(strides),
+                                 data,
+                                 std::move(owner)});
+  return from_local_buffers(std::move(buffs)).front();
 }
 
 FACTORY_INIT(DeferredFromLocal, F_FROMLOCALS);
+FACTORY_INIT(DeferredToDLPack, F_TODLPACK);
+FACTORY_INIT(DeferredSave, F_SAVE);
+FACTORY_INIT(DeferredLoad, F_LOAD);
 } // namespace SHARPY
@@ -0,0 +1,487 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Capture and replay of jitted functions (see JitFunc.hpp).
+*/
+
+#include "sharpy/JitFunc.hpp"
+#include "sharpy/CommStats.hpp"
+#include "sharpy/Deferred.hpp"
+#include "sharpy/NDArray.hpp"
+#include "sharpy/Registry.hpp"
+#include "sharpy/Service.hpp"
+#include "sharpy/Transceiver.hpp"
+#include "sharpy/jit/mlir.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+
+namespace SHARPY {
+
+/// @brief a result of the recorded function: where to find it in the output
+/// buffer, which argument/output it belongs to and what it looks like
+struct RecordedResult {
+  int _rank;
+  bool _isDist;
+  size_t _pos;
+  int _arg = -1;   // index of argument which is updated in-place
+  int _out = -1;   // index of output
+  int _alias = -1; // index of argument which is delivered (in-place ops)
+  DTypeId _dtype;
+  shape_type _shape;
+  std::string _device;
+  uint64_t _team;
+  std::shared_ptr<const std::vector<int64_t>> _layout;
+};
+
+struct JitRecording::State {
+  jit::Recording _rec;
+  std::vector<id_type> _args;
+  std::vector<id_type> _outputs;
+  // filled when recording stops
+  std::vector<int> _inputArgs; // argument index of each recorded input
+  std::vector<std::shared_ptr<const std::vector<int64_t>>> _inputLayouts;
+  std::vector<RecordedResult> _results;
+  std::string _error;
+  std::atomic<bool> _stale{false};
+  std::promise<void> _done;
+};
+
+/// @brief output buffer of a replay, shared by the arrays it produces
+struct Replayed {
+  std::vector<intptr_t> _output;
+  std::exception_ptr _error;
+};
+
+template <typename T> static int index_of(const std::vector<T> &v, T x) {
+  auto i = std::find(v.begin(), v.end(), x);
+  return i == v.end() ? -1 : static_cast<int>(i - v.begin());
+}
+
+// FNV-1a, the same on all processes
+static uint64_t layout_hash(const std::vector<int64_t> &layout) {
+  uint64_t h = 14695981039346656037ull;
+  for (auto v : layout) {
+    h = (h ^ static_cast<uint64_t>(v)) * 1099511628211ull;
+  }
+  return h;
+}
+
+// splitmix64 finalizer
+static uint64_t mix(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// Append to each local layout a fingerprint of the layouts all processes
+// have for the same array. Signatures including it match on all processes
+// or on none, even if only some local layouts differ (e.g. irregular
+// partitions). Collective, must run in the worker thread.
+static void add_fingerprints(std::vector<std::vector<int64_t>> &layouts) {
+  auto trscvr = getTransceiver();
+  auto salt = mix(trscvr->rank() + 1);
+  std::vector<uint64_t> fps;
+  for (auto &l : layouts) {
+    fps.emplace_back(mix(layout_hash(l) ^ salt));
+  }
+  if (trscvr->nranks() > 1 && !fps.empty()) {
+    COMM_SITE("jit");
+    trscvr->reduce_all(fps.data(), UINT64, fps.size(), SUM);
+  }
+  for (size_t i = 0; i < layouts.size(); ++i) {
+    layouts[i].emplace_back(static_cast<int64_t>(fps[i]));
+  }
+}
+
+// @return true if pred holds on all processes
+// Collective, must run in the worker thread.
+static bool on_all_ranks(bool pred) {
+  auto trscvr = getTransceiver();
+  if (trscvr->nranks() == 1) {
+    return pred;
+  }
+  COMM_SITE("jit");
+  int64_t v = pred;
+  trscvr->reduce_all(&v, INT64, 1, MIN);
+  return v != 0;
+}
+
+// turn the layouts of a checked recording into layout hints
+// Collective, must run in the worker thread.
+static void fingerprint_recording(JitRecording::State &st) {
+  std::vector<std::vector<int64_t>> layouts;
+  for (auto &l : st._inputLayouts) {
+    layouts.emplace_back(*l);
+  }
+  for (auto &r : st._results) {
+    layouts.emplace_back(*r._layout);
+  }
+  add_fingerprints(layouts);
+  size_t i = 0;
+  for (auto &l : st._inputLayouts) {
+    l = std::make_shared<const std::vector<int64_t>>(std::move(layouts[i++]));
+  }
+  for (auto &r : st._results) {
+    r._layout =
+        std::make_shared<const std::vector<int64_t>>(std::move(layouts[i++]));
+  }
+}
+
+// check that the recorded function can be replayed and map its inputs and
+// results to arguments and outputs
+// @return empty string on success, reason otherwise
+static std::string check_recording(JitRecording::State &st) {
+  auto &rec = st._rec;
+  // the marker which stops the recording is the only op allowed to run
+  if (rec._nFuncs != 1 || rec._nRuns != 1) {
+    return "function did not compile into a single jitted function";
+  }
+  for (auto o : st._outputs) {
+    if (index_of(st._args, o) >= 0) {
+      return "function returns its arguments";
+    }
+  }
+  for (auto &in : rec._inputs) {
+    auto i = index_of(st._args, in._guid);
+    if (i < 0) {
+      return "function reads arrays which are not arguments";
+    }
+    st._inputArgs.emplace_back(i);
+    st._inputLayouts.emplace_back(
+        std::make_shared<const std::vector<int64_t>>(in._layout));
+  }
+
+  // the arrays the function got as input
+  std::vector<array_i::ptr_type> inputs;
+  for (auto i : st._inputArgs) {
+    inputs.emplace_back(Registry::get(st._args[i]).get());
+  }
+
+  // walk the output buffer to find the position of each result
+  std::vector<intptr_t> buff(rec._osz);
+  size_t pos = 0;
+  for (auto &r : rec._results) {
+    RecordedResult res{r._rank, r._isDist, pos};
+    pos += jit::deliver_result(r._rank, r._isDist, &buff[pos], nullptr);
+    if (!r._deliver) {
+      continue; // e.g. an input which was not modified
+    }
+    res._arg = index_of(st._args, r._guid);
+    res._out = index_of(st._outputs, r._guid);
+    if (res._arg < 0 && res._out < 0) {
+      return "function creates arrays which are not returned";
+    }
+    auto fut = Registry::get(r._guid);
+    auto ary = std::dynamic_pointer_cast<NDArray>(fut.get());
+    if (!ary) {
+      return "function produces unexpected results";
+    }
+    // in-place ops deliver their input array, others must own their data
+    res._alias = index_of(inputs, fut.get());
+    if (res._alias >= 0) {
+      res._alias = st._inputArgs[res._alias];
+    } else if (ary->base()) {
+      return "function returns views of arrays";
+    }
+    res._dtype = fut.dtype();
+    res._shape = fut.shape();
+    res._device = fut.device();
+    res._team = fut.team();
+    res._layout = std::make_shared<const std::vector<int64_t>>(
+        jit::layout_of(ary.get()));
+    st._results.emplace_back(std::move(res));
+  }
+
+  for (int o = 0; o < static_cast<int>(st._outputs.size()); ++o) {
+    if (std::none_of(st._results.begin(), st._results.end(),
+                     [o](const RecordedResult &r) { return r._out == o; })) {
+      return "function returns arrays which it did not compute";
+    }
+  }
+  return {};
+}
+
+/// @brief an array produced by replaying a recording
+struct DeferredReplayed : public Deferred {
+  std::shared_ptr<Replayed> _replayed;
+  int _rank;
+  bool _isDist;
+  size_t _pos;
+  id_type _alias;
+
+  DeferredReplayed(const std::shared_ptr<Replayed> &replayed,
+                   const RecordedResult &res, id_type guid,
+                   id_type alias = Registry::NOGUID)
+      : Deferred(res._dtype, res._shape, res._device, res._team, guid),
+        _replayed(replayed), _rank(res._rank), _isDist(res._isDist),
+        _pos(res._pos), _alias(alias) {}
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    // the replay was executed before, we only pick up our result
+    if (_replayed->_error) {
+      set_exception(_replayed->_error);
+      return false;
+    }
+    if (_alias != Registry::NOGUID) {
+      // result of an in-place op, data was updated in-place
+      this->set_value(Registry::get(_alias).get());
+      return false;
+    }
+    jit::deliver_result(
+        _rank, _isDist, &_replayed->_output[_pos],
+        [this](uint64_t rank, void *l_allocated, void *l_aligned,
+               intptr_t l_offset, const intptr_t *l_sizes,
+               const intptr_t *l_strides, void *o_allocated, void *o_aligned,
+               intptr_t o_offset, const intptr_t *o_sizes,
+               const intptr_t *o_strides, void *r_allocated, void *r_aligned,
+               intptr_t r_offset, const intptr_t *r_sizes,
+               const intptr_t *r_strides, std::vector<int64_t> &&loffs) {
+          this->set_value(mk_tnsr(
+              this->guid(), this->dtype(), this->shape(), this->device(),
+              this->team(), l_allocated, l_aligned, l_offset, l_sizes,
+              l_strides, o_allocated, o_aligned, o_offset, o_sizes, o_strides,
+              r_allocated, r_aligned, r_offset, r_sizes, r_strides,
+              std::move(loffs)));
+        });
+    return false;
+  }
+
+  FactoryId factory() const override {
+    throw(std::runtime_error("No Factory for DeferredReplayed."));
+  }
+};
+
+JitRecording::JitRecording(const std::vector<FutureArray *> &args)
+    : _state(std::make_shared<State>()) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("jit is not supported in c/w mode");
+  }
+  for (auto a : args) {
+    _state->_args.emplace_back(a->get().guid());
+  }
+  // everything deferred before goes into a separate function
+  defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+               [state = _state]() {
+                 jit::DepManager::setRecording(&state->_rec);
+               });
+}
+
+std::string JitRecording::finish(const std::vector<FutureArray *> &outputs) {
+  for (auto o : outputs) {
+    _state->_outputs.emplace_back(o->get().guid());
+  }
+  auto done = _state->_done.get_future();
+  defer_lambda(
+      [](auto &&, auto &&, auto &&) { return true; },
+      [state = _state]() {
+        if (jit::DepManager::recording() == &state->_rec) {
+          jit::DepManager::setRecording(nullptr);
+          try {
+            state->_error = check_recording(*state);
+          } catch (std::exception &e) {
+            state->_error = e.what();
+          }
+        } else {
+          // another recording was started in between
+          state->_error = "nested jit recording";
+        }
+        // a process which replays while others run the function would pair
+        // up mismatched collectives
+        try {
+          if (!on_all_ranks(state->_error.empty())) {
+            if (state->_error.empty()) {
+              state->_error = "function cannot be captured on all processes";
+            }
+          } else {
+            fingerprint_recording(*state);
+          }
+        } catch (std::exception &e) {
+          state->_error = e.what();
+        }
+        state->_done.set_value();
+      });
+  {
+    py::gil_scoped_release release;
+    Service::run();
+    done.get();
+  }
+
+  if (_state->_error.empty()) {
+    for (auto &r : _state->_results) {
+      if (r._out >= 0) {
+        outputs[r._out]->set_layout_hint(r._layout);
+      }
+    }
+  }
+  return _state->_error;
+}
+
+std::vector<FutureArray *>
+JitRecording::replay(const std::vector<FutureArray *> &args) {
+  if (!valid()) {
+    throw std::runtime_error("Cannot replay invalid jit recording.");
+  }
+  if (args.size() != _state->_args.size()) {
+    throw std::invalid_argument("Number of arguments differs from recording.");
+  }
+  std::vector<id_type> ids;
+  for (auto a : args) {
+    ids.emplace_back(a->get().guid());
+  }
+
+  auto replayed = std::make_shared<Replayed>();
+  defer_lambda(
+      [](auto &&, auto &&, auto &&) { return true; },
+      [state = _state, replayed, ids]() {
+        auto &rec = state->_rec;
+        std::vector<void *> inputs;
+        try {
+          py::gil_scoped_release release;
+          std::vector<std::shared_ptr<NDArray>> arys;
+          std::exception_ptr err;
+          bool match = true;
+          try {
+            for (size_t i = 0; i < rec._inputs.size(); ++i) {
+              auto ary = std::dynamic_pointer_cast<NDArray>(
+                  Registry::get(ids[state->_inputArgs[i]]).get());
+              match = match && ary &&
+                      jit::layout_of(ary.get()) == rec._inputs[i]._layout;
+              arys.emplace_back(std::move(ary));
+            }
+          } catch (...) {
+            err = std::current_exception();
+            match = false;
+          }
+          // the function communicates: all processes replay or none
+          if (!on_all_ranks(match)) {
+            state->_stale = true;
+            if (err) {
+              std::rethrow_exception(err);
+            }
+            throw std::runtime_error(
+                match ? "Argument layout differs from jit recording on "
+                        "another process."
+                      : "Argument layout differs from jit recording.");
+          }
+          for (auto &ary : arys) {
+            jit::add_inputs(ary.get(), inputs);
+          }
+          replayed->_output = jit::JIT::invoke(rec._func, inputs, rec._osz);
+        } catch (...) {
+          replayed->_error = std::current_exception();
+        }
+        for (auto p : inputs) {
+          delete[] static_cast<intptr_t *>(p);
+        }
+      });
+
+  // inputs keep their layout unless they get replaced below
+  for (size_t i = 0; i < _state->_inputArgs.size(); ++i) {
+    args[_state->_inputArgs[i]]->set_layout_hint(_state->_inputLayouts[i]);
+  }
+  // the arrays get their values from the replay
+  std::vector<FutureArray *> res(_state->_outputs.size(), nullptr);
+  for (auto &r : _state->_results) {
+    auto alias = r._alias >= 0 ? ids[r._alias] : Registry::NOGUID;
+    if (r._arg >= 0) {
+      auto a = args[r._arg];
+      a->put(defer<DeferredReplayed>(replayed, r, ids[r._arg], alias));
+      a->set_layout_hint(r._layout);
+    } else {
+      res[r._out] = new FutureArray(
+          defer<DeferredReplayed>(replayed, r, Registry::NOGUID, alias));
+      res[r._out]->set_layout_hint(r._layout);
+    }
+  }
+  return res;
+}
+
+bool JitRecording::valid() const {
+  return _state->_error.empty() && !_state->_stale;
+}
+
+py::bytes jit_signature(const std::vector<FutureArray *> &args) {
+  // layouts are only known once the arrays are computed
+  std::vector<std::shared_ptr<const std::vector<int64_t>>> layouts;
+  bool sync = false;
+  for (auto a : args) {
+    layouts.emplace_back(a->layout_hint());
+    sync = sync || !layouts.back();
+  }
+  if (sync) {
+    // the fingerprints need all processes, computed in the worker thread
+    std::vector<id_type> ids;
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!layouts[i]) {
+        ids.emplace_back(args[i]->get().guid());
+      }
+    }
+    using layouts_type = std::vector<std::vector<int64_t>>;
+    auto promise = std::make_shared<std::promise<layouts_type>>();
+    auto fut = promise->get_future();
+    defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+                 [promise, ids]() {
+                   try {
+                     layouts_type res;
+                     for (auto id : ids) {
+                       auto ary = std::dynamic_pointer_cast<NDArray>(
+                           Registry::get(id).get());
+                       if (!ary) {
+                         throw std::invalid_argument(
+                             "Expected NDArray in jit.");
+                       }
+                       res.emplace_back(jit::layout_of(ary.get()));
+                     }
+                     add_fingerprints(res);
+                     promise->set_value(std::move(res));
+                   } catch (...) {
+                     promise->set_exception(std::current_exception());
+                   }
+                 });
+    layouts_type computed;
+    {
+      py::gil_scoped_release release;
+      Service::run();
+      computed = fut.get();
+    }
+    size_t k = 0;
+    for (size_t i = 0; i < args.size(); ++i) {
+      if (!layouts[i]) {
+        layouts[i] = std::make_shared<const std::vector<int64_t>>(
+            std::move(computed[k++]));
+        args[i]->set_layout_hint(layouts[i]);
+      }
+    }
+  }
+
+  std::vector<int64_t> key;
+  std::string devices;
+  for (size_t i = 0; i < args.size(); ++i) {
+    auto &f = args[i]->get();
+    // arguments referring to the same array
+    int64_t alias = i;
+    for (size_t j = 0; j < i; ++j) {
+      if (args[j]->get().guid() == f.guid()) {
+        alias = j;
+        break;
+      }
+    }
+    key.emplace_back(alias);
+    key.emplace_back(f.dtype());
+    key.emplace_back(f.team() != 0);
+    key.emplace_back(f.rank());
+    key.insert(key.end(), f.shape().begin(), f.shape().end());
+    key.emplace_back(layouts[i]->size());
+    key.insert(key.end(), layouts[i]->begin(), layouts[i]->end());
+    devices += f.device();
+    devices.push_back('\0');
+  }
+  return py::bytes(std::string(reinterpret_cast<const char *>(key.data()),
+                               key.size() * sizeof(int64_t)) +
+                   devices);
+}
+
+} // namespace SHARPY
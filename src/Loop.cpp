@@ -0,0 +1,364 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Loops over arrays, generating scf.for and scf.while (see Loop.hpp).
+*/
+
+#include "sharpy/Loop.hpp"
+#include "sharpy/Deferred.hpp"
+#include "sharpy/FutureArray.hpp"
+#include "sharpy/NDArray.hpp"
+#include "sharpy/Registry.hpp"
+#include "sharpy/Transceiver.hpp"
+#include "sharpy/jit/mlir.hpp"
+
+#include <imex/Dialect/Dist/IR/DistOps.h>
+#include <imex/Dialect/Dist/Utils/Utils.h>
+#include <imex/Dialect/NDArray/IR/NDArrayOps.h>
+#include <imex/Utils/PassUtils.h>
+
+#include <mlir/Dialect/Arith/IR/Arith.h>
+#include <mlir/Dialect/SCF/IR/SCF.h>
+#include <mlir/Dialect/Tensor/IR/Tensor.h>
+#include <mlir/IR/Builders.h>
+
+#include <unordered_set>
+
+namespace SHARPY {
+
+// Caller-side bookkeeping, only touched with the GIL held.
+// Arrays created in the bodies of the loops being captured (innermost last)
+static std::vector<std::unordered_set<id_type>> _bodies;
+// Arrays created in the body of a loop which ended
+static std::unordered_set<id_type> _scoped;
+
+void Loop::check_sync() {
+  if (!_bodies.empty()) {
+    throw std::runtime_error(
+        "Cannot synchronize in a loop body (e.g. convert an array to a "
+        "Python value or query its shape).");
+  }
+}
+
+void Loop::created(id_type guid) {
+  if (!_bodies.empty()) {
+    _bodies.back().insert(guid);
+  }
+}
+
+void Loop::check_scoped(id_type guid) {
+  if (!_scoped.empty() && _scoped.count(guid)) {
+    throw std::runtime_error(
+        "array computed in a loop body cannot be used outside the loop");
+  }
+}
+
+void Loop::released(id_type guid) {
+  for (auto &body : _bodies) {
+    body.erase(guid);
+  }
+  if (!_scoped.empty()) {
+    _scoped.erase(guid);
+  }
+}
+
+void Loop::close_body() {
+  auto &body = _bodies.back();
+  _scoped.insert(body.begin(), body.end());
+  _bodies.pop_back();
+}
+
+struct Loop::State {
+  enum Phase { BEGIN, COND, BODY, END };
+  int64_t _n;
+  std::vector<array_i::future_type> _init;
+  Phase _phase = BEGIN;
+  // set while generating MLIR
+  ::mlir::Operation *_op = nullptr;
+  ::mlir::SmallVector<::mlir::Value> _args; // block arguments
+  ::mlir::SmallVector<::mlir::Type> _types; // types of carried arrays
+};
+
+/// @brief an array carried by a loop, the argument of the current block
+struct DeferredLoopArg : public Deferred {
+  std::shared_ptr<Loop::State> _loop;
+  size_t _idx;
+
+  DeferredLoopArg(const std::shared_ptr<Loop::State> &loop, size_t idx,
+                  const array_i::future_type &a)
+      : Deferred(a.dtype(), a.shape(), a.device(), a.team()), _loop(loop),
+        _idx(idx) {}
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    // only visible in the loop, never delivered
+    dm.addVal(this->guid(), _loop->_args[_idx], {});
+    return false;
+  }
+
+  FactoryId factory() const override {
+    throw(std::runtime_error("No Factory for DeferredLoopArg."));
+  }
+};
+
+/// @brief the iteration index of a for-loop as a 0d array
+struct DeferredLoopIndex : public Deferred {
+  std::shared_ptr<Loop::State> _loop;
+
+  DeferredLoopIndex(const std::shared_ptr<Loop::State> &loop,
+                    const std::string &device, uint64_t team)
+      : Deferred(INT64, shape_type{}, device, team), _loop(loop) {}
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    auto idx = builder.create<::mlir::arith::IndexCastOp>(
+        loc, builder.getI64Type(), _loop->_args[0]);
+    auto envs = jit::mkEnvs(builder, 0, device(), team());
+    dm.addVal(this->guid(),
+              builder.create<::imex::ndarray::CreateOp>(
+                  loc, ::mlir::SmallVector<::mlir::Value>{},
+                  ::imex::ndarray::I64, idx, envs),
+              {});
+    return false;
+  }
+
+  FactoryId factory() const override {
+    throw(std::runtime_error("No Factory for DeferredLoopIndex."));
+  }
+};
+
+/// @brief the final value of an array carried by a loop
+struct DeferredLoopResult : public Deferred {
+  std::shared_ptr<Loop::State> _loop;
+  size_t _idx;
+
+  DeferredLoopResult(const std::shared_ptr<Loop::State> &loop, size_t idx,
+                     const array_i::future_type &a)
+      : Deferred(a.dtype(), a.shape(), a.device(), a.team()), _loop(loop),
+        _idx(idx) {}
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    dm.addVal(
+        this->guid(), _loop->_op->getResult(_idx),
+        [this](uint64_t rank, void *l_allocated, void *l_aligned,
+               intptr_t l_offset, const intptr_t *l_sizes,
+               const intptr_t *l_strides, void *o_allocated, void *o_aligned,
+               intptr_t o_offset, const intptr_t *o_sizes,
+               const intptr_t *o_strides, void *r_allocated, void *r_aligned,
+               intptr_t r_offset, const intptr_t *r_sizes,
+               const intptr_t *r_strides, std::vector<int64_t> &&loffs) {
+          this->set_value(mk_tnsr(
+              this->guid(), this->dtype(), this->shape(), this->device(),
+              this->team(), l_allocated, l_aligned, l_offset, l_sizes,
+              l_strides, o_allocated, o_aligned, o_offset, o_sizes, o_strides,
+              r_allocated, r_aligned, r_offset, r_sizes, r_strides,
+              std::move(loffs)));
+        });
+    return false;
+  }
+
+  FactoryId factory() const override {
+    throw(std::runtime_error("No Factory for DeferredLoopResult."));
+  }
+};
+
+// convert a 0d array into a i1 (true if not zero)
+static ::mlir::Value to_flag(::mlir::OpBuilder &builder,
+                             const ::mlir::Location &loc, ::mlir::Value val) {
+  if (::imex::dist::isDist(val.getType())) {
+    // 0d arrays are replicated, use the local data
+    auto parts = builder.create<::imex::dist::PartsOfOp>(loc, val).getResults();
+    val = parts.size() == 1 ? parts[0] : parts[1];
+  }
+  auto tnsr = builder.create<::imex::ndarray::ToTensorOp>(loc, val);
+  ::mlir::Value v = builder.create<::mlir::tensor::ExtractOp>(
+      loc, tnsr, ::mlir::ValueRange{});
+  auto typ = v.getType();
+  if (typ.isInteger(1)) {
+    return v;
+  }
+  auto zero = builder.create<::mlir::arith::ConstantOp>(
+      loc, builder.getZeroAttr(typ));
+  if (typ.isa<::mlir::FloatType>()) {
+    return builder.create<::mlir::arith::CmpFOp>(
+        loc, ::mlir::arith::CmpFPredicate::UNE, v, zero);
+  }
+  return builder.create<::mlir::arith::CmpIOp>(
+      loc, ::mlir::arith::CmpIPredicate::ne, v, zero);
+}
+
+Loop::Loop(const std::vector<FutureArray *> &state, int64_t n)
+    : _state(std::make_shared<State>()) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("loops are not supported in c/w mode");
+  }
+  _state->_n = n;
+  for (auto a : state) {
+    _state->_init.emplace_back(a->get());
+  }
+
+  defer_lambda(
+      [st = _state](::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                    jit::DepManager &dm) {
+        ::mlir::SmallVector<::mlir::Value> inits;
+        for (auto &a : st->_init) {
+          inits.emplace_back(dm.getDependent(builder, Registry::get(a.guid())));
+          st->_types.emplace_back(inits.back().getType());
+        }
+        if (st->_n >= 0) {
+          auto lb = ::imex::createIndex(loc, builder, 0);
+          auto ub = ::imex::createIndex(loc, builder, st->_n);
+          auto step = ::imex::createIndex(loc, builder, 1);
+          auto forOp =
+              builder.create<::mlir::scf::ForOp>(loc, lb, ub, step, inits);
+          st->_op = forOp;
+          st->_args.emplace_back(forOp.getInductionVar());
+          st->_args.append(forOp.getRegionIterArgs().begin(),
+                           forOp.getRegionIterArgs().end());
+          builder.setInsertionPointToStart(forOp.getBody());
+        } else {
+          auto whileOp = builder.create<::mlir::scf::WhileOp>(
+              loc, st->_types, inits, nullptr, nullptr);
+          st->_op = whileOp;
+          st->_args.append(whileOp.getBeforeArguments().begin(),
+                           whileOp.getBeforeArguments().end());
+          builder.setInsertionPointToStart(whileOp.getBeforeBody());
+        }
+        dm.beginRegion(st->_op);
+        return false;
+      },
+      []() {});
+  _bodies.emplace_back();
+}
+
+std::vector<FutureArray *> Loop::args() {
+  if (_state->_phase != State::BEGIN) {
+    throw std::runtime_error("Loop arguments were already requested.");
+  }
+  _state->_phase = _state->_n >= 0 ? State::BODY : State::COND;
+  std::vector<FutureArray *> res;
+  size_t i = 0;
+  if (_state->_n >= 0) {
+    // the index lives where the (first) carried array lives
+    std::string device;
+    uint64_t team = 0;
+    if (!_state->_init.empty()) {
+      device = _state->_init.front().device();
+      team = _state->_init.front().team();
+    }
+    res.emplace_back(
+        new FutureArray(defer<DeferredLoopIndex>(_state, device, team)));
+    ++i;
+  }
+  for (auto &a : _state->_init) {
+    res.emplace_back(new FutureArray(defer<DeferredLoopArg>(_state, i++, a)));
+  }
+  return res;
+}
+
+std::vector<FutureArray *> Loop::condition(const FutureArray &cond) {
+  if (_state->_phase != State::COND) {
+    throw std::runtime_error("Unexpected loop condition.");
+  }
+  if (cond.get().rank() != 0) {
+    throw std::invalid_argument("Loop condition must be a 0d array.");
+  }
+  _state->_phase = State::BODY;
+
+  defer_lambda(
+      [st = _state, c = cond.get().guid()](::mlir::OpBuilder &builder,
+                                           const ::mlir::Location &loc,
+                                           jit::DepManager &dm) {
+        auto whileOp = ::mlir::cast<::mlir::scf::WhileOp>(st->_op);
+        auto flag = to_flag(builder, loc,
+                            dm.getDependent(builder, Registry::get(c)));
+        // the carried arrays are forwarded unchanged to the body
+        builder.create<::mlir::scf::ConditionOp>(loc, flag, st->_args);
+        st->_args.assign(whileOp.getAfterArguments().begin(),
+                         whileOp.getAfterArguments().end());
+        builder.setInsertionPointToStart(whileOp.getAfterBody());
+        return false;
+      },
+      []() {});
+
+  std::vector<FutureArray *> res;
+  size_t i = 0;
+  for (auto &a : _state->_init) {
+    res.emplace_back(new FutureArray(defer<DeferredLoopArg>(_state, i++, a)));
+  }
+  return res;
+}
+
+std::vector<FutureArray *>
+Loop::end(const std::vector<FutureArray *> &state) {
+  if (_state->_phase != State::BODY) {
+    throw std::runtime_error("Unexpected end of loop.");
+  }
+  auto &init = _state->_init;
+  if (state.size() != init.size()) {
+    throw std::invalid_argument(
+        "Loop body must return as many arrays as it got.");
+  }
+  std::vector<id_type> ids;
+  for (size_t i = 0; i < state.size(); ++i) {
+    auto &a = state[i]->get();
+    if (a.dtype() != init[i].dtype() || a.shape() != init[i].shape() ||
+        a.device() != init[i].device() || !a.team() != !init[i].team()) {
+      throw std::invalid_argument(
+          "Loop body must not change dtype, shape, device or team of arrays.");
+    }
+    ids.emplace_back(a.guid());
+  }
+  _state->_phase = State::END;
+
+  defer_lambda(
+      [st = _state, ids](::mlir::OpBuilder &builder,
+                         const ::mlir::Location &loc, jit::DepManager &dm) {
+        ::mlir::SmallVector<::mlir::Value> vals;
+        for (size_t i = 0; i < ids.size(); ++i) {
+          auto v = dm.getDependent(builder, Registry::get(ids[i]));
+          if (v.getType() != st->_types[i]) {
+            // e.g. partitioning/halos changed
+            v = builder.create<::imex::ndarray::CastOp>(loc, st->_types[i], v);
+          }
+          vals.emplace_back(v);
+        }
+        // for-loops without carried arrays already have a terminator
+        if (!builder.getInsertionBlock()->mightHaveTerminator()) {
+          builder.create<::mlir::scf::YieldOp>(loc, vals);
+        }
+        builder.setInsertionPointAfter(st->_op);
+        dm.endRegion(st->_op);
+        return false;
+      },
+      []() {});
+  close_body();
+
+  std::vector<FutureArray *> res;
+  for (size_t i = 0; i < init.size(); ++i) {
+    res.emplace_back(
+        new FutureArray(defer<DeferredLoopResult>(_state, i, init[i])));
+  }
+  return res;
+}
+
+void Loop::abort() {
+  if (_state->_phase == State::END) {
+    return;
+  }
+  _state->_phase = State::END;
+  close_body();
+  defer_lambda(
+      [st = _state](::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                    jit::DepManager &dm) {
+        builder.setInsertionPointAfter(st->_op);
+        dm.endRegion(st->_op);
+        st->_op->erase();
+        st->_op = nullptr;
+        return false;
+      },
+      []() {});
+}
+
+} // namespace SHARPY
@@ -5,12 +5,15 @@
 */
 
 #include "sharpy/MPITransceiver.hpp"
+#include "sharpy/CommStats.hpp"
+#include "sharpy/Trace.hpp"
 #include "sharpy/UtilsAndTypes.hpp"
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <mpi.h>
 #include <sstream>
+#include <vector>
 
 namespace SHARPY {
 
@@ -185,15 +188,60 @@ static MPI_Op to_mpi(RedOpType o) {
   }
 }
 
-void MPITransceiver::barrier() { MPI_Barrier(_comm); }
+// @return start time if communication gets profiled, 0 otherwise
+static uint64_t comm_begin() { return comm::enabled() ? trace::now() : 0; }
+
+// record communication of this rank which started at begin;
+// toRank[i] are the bytes sent to rank i, own bytes are not counted
+static void comm_end(uint64_t begin, comm::Collective c, rank_type me,
+                     std::vector<uint64_t> &&toRank = {}) {
+  auto ns = trace::now() - begin;
+  if (toRank.empty()) {
+    comm::record(c, 0, nullptr, ns);
+    return;
+  }
+  toRank[me] = 0;
+  uint64_t bytes = 0;
+  for (auto b : toRank) {
+    bytes += b;
+  }
+  comm::record(c, bytes, toRank.data(), ns);
+}
+
+// @return bytes sent to each rank given counts of elements of type T
+static std::vector<uint64_t> to_bytes(rank_type n, const int *counts,
+                                      DTypeId T) {
+  std::vector<uint64_t> res(n);
+  for (rank_type i = 0; i < n; ++i) {
+    res[i] = counts[i] * sizeof_dtype(T);
+  }
+  return res;
+}
+
+void MPITransceiver::barrier() {
+  auto begin = comm_begin();
+  MPI_Barrier(_comm);
+  if (begin)
+    comm_end(begin, comm::BARRIER, _rank);
+}
 
 void MPITransceiver::bcast(void *ptr, size_t N, rank_type root) {
+  auto begin = comm_begin();
   MPI_Bcast(ptr, N, MPI_CHAR, root, _comm);
+  if (begin)
+    comm_end(begin, comm::BCAST, _rank,
+             root == _rank ? std::vector<uint64_t>(_nranks, N)
+                           : std::vector<uint64_t>());
 }
 
 void MPITransceiver::reduce_all(void *inout, DTypeId T, size_t N,
                                 RedOpType op) {
+  auto begin = comm_begin();
   MPI_Allreduce(MPI_IN_PLACE, inout, N, to_mpi(T), to_mpi(op), _comm);
+  // traffic depends on MPI's algorithm, we count the payload only
+  if (begin)
+    comm::record(comm::ALLREDUCE, N * sizeof_dtype(T), nullptr,
+                 trace::now() - begin);
 }
 
 Transceiver::WaitHandle
@@ -201,49 +249,97 @@ MPITransceiver::alltoall(const void *buffer_send, const int *counts_send,
                          const int *displacements_send, DTypeId datatype,
                          void *buffer_recv, const int *counts_recv,
                          const int *displacements_recv) {
+  auto begin = comm_begin();
   MPI_Request request;
   MPI_Ialltoallv(buffer_send, counts_send, displacements_send, to_mpi(datatype),
                  buffer_recv, counts_recv, displacements_recv, to_mpi(datatype),
                  _comm, &request);
   static_assert(sizeof(request) == sizeof(WaitHandle));
-  return static_cast<WaitHandle>(request);
+  auto handle = static_cast<WaitHandle>(request);
+  if (begin) {
+    comm_end(begin, comm::ALLTOALLV, _rank,
+             to_bytes(_nranks, counts_send, datatype));
+    comm::issued(comm::ALLTOALLV, handle);
+  }
+  return handle;
 }
 
 void MPITransceiver::alltoall(const void *buffer_send, const int counts,
                               DTypeId datatype, void *buffer_recv) {
+  auto begin = comm_begin();
   MPI_Alltoall(buffer_send, counts, to_mpi(datatype), buffer_recv, counts,
                to_mpi(datatype), _comm);
+  if (begin)
+    comm_end(begin, comm::ALLTOALL, _rank,
+             std::vector<uint64_t>(_nranks, counts * sizeof_dtype(datatype)));
 }
 
 void MPITransceiver::gather(void *buffer, const int *counts,
                             const int *displacements, DTypeId datatype,
                             rank_type root) {
+  auto begin = comm_begin();
   auto dtype = to_mpi(datatype);
+  auto mine = counts[_rank] * sizeof_dtype(datatype);
   if (root == REPLICATED) {
     MPI_Allgatherv(MPI_IN_PLACE, 0, dtype, buffer, counts, displacements, dtype,
                    _comm);
+    if (begin)
+      comm_end(begin, comm::ALLGATHERV, _rank,
+               std::vector<uint64_t>(_nranks, mine));
   } else {
+    std::vector<uint64_t> toRank(_nranks, 0);
     if (root == _rank) {
       MPI_Gatherv(MPI_IN_PLACE, 0, dtype, buffer, counts, displacements, dtype,
                   root, _comm);
     } else {
       MPI_Gatherv(buffer, counts[_rank], dtype, nullptr, nullptr, nullptr,
                   dtype, root, _comm);
+      toRank[root] = mine;
     }
+    if (begin)
+      comm_end(begin, comm::GATHERV, _rank, std::move(toRank));
+  }
+}
+
+void MPITransceiver::scatter(void *buffer, const int *counts,
+                             const int *displacements, DTypeId datatype,
+                             rank_type root) {
+  auto begin = comm_begin();
+  auto dtype = to_mpi(datatype);
+  if (root == _rank) {
+    MPI_Scatterv(buffer, counts, displacements, dtype, MPI_IN_PLACE, 0, dtype,
+                 root, _comm);
+    if (begin)
+      comm_end(begin, comm::SCATTERV, _rank,
+               to_bytes(_nranks, counts, datatype));
+  } else {
+    MPI_Scatterv(nullptr, nullptr, nullptr, dtype, buffer, counts[_rank],
+                 dtype, root, _comm);
+    if (begin)
+      comm_end(begin, comm::SCATTERV, _rank);
   }
 }
 
 void MPITransceiver::send_recv(void *buffer_send, int count_send,
                                DTypeId datatype_send, int dest, int source) {
   constexpr int SRTAG = 505;
+  auto begin = comm_begin();
   MPI_Sendrecv_replace(buffer_send, count_send, to_mpi(datatype_send), dest,
                        SRTAG, source, SRTAG, _comm, MPI_STATUS_IGNORE);
+  if (begin) {
+    std::vector<uint64_t> toRank(_nranks, 0);
+    toRank[dest] = count_send * sizeof_dtype(datatype_send);
+    comm_end(begin, comm::SENDRECV, _rank, std::move(toRank));
+  }
 }
 
 void MPITransceiver::wait(WaitHandle h) {
   if (h) {
+    auto begin = comm_begin();
     auto r = static_cast<MPI_Request>(h);
     MPI_Wait(&r, MPI_STATUS_IGNORE);
+    if (begin)
+      comm::waited(h, trace::now() - begin);
   }
 }
 } // namespace SHARPY
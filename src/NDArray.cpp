@@ -3,6 +3,7 @@
 // Concrete implementation of array_i.
 // Interfaces are based on shared_ptr<array_i>.
 
+#include <sharpy/CommStats.hpp>
 #include <sharpy/CppTypes.hpp>
 #include <sharpy/Deferred.hpp>
 #include <sharpy/NDArray.hpp>
@@ -244,6 +245,7 @@ int64_t NDArray::__int__() const {
 void NDArray::replicate() {
   if (is_replicated())
     return;
+  COMM_SITE("replicate");
   auto gsz = size();
   auto lsz = local_size();
   if (gsz > 1)
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Starting and stopping the runtime (see Runtime.hpp).
+*/
+
+#include "sharpy/Runtime.hpp"
+#include "sharpy/CommStats.hpp"
+#include "sharpy/Deferred.hpp"
+#include "sharpy/MPIMediator.hpp"
+#include "sharpy/MPITransceiver.hpp"
+#include "sharpy/Registry.hpp"
+#include "sharpy/Service.hpp"
+#include "sharpy/Trace.hpp"
+#include "sharpy/itac.hpp"
+#include "sharpy/jit/PassTiming.hpp"
+#include "sharpy/jit/Roofline.hpp"
+#include "sharpy/jit/mlir.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sched.h>
+#include <thread>
+
+namespace SHARPY {
+
+rank_type myrank() { return getTransceiver()->rank(); }
+
+std::thread *pprocessor = nullptr;
+
+extern bool inited;
+extern bool finied;
+
+void sync_promises() {
+  int vtWaitSym, vtSHARPYClass;
+  VT(VT_classdef, "sharpy", &vtSHARPYClass);
+  VT(VT_funcdef, "wait", vtSHARPYClass, &vtWaitSym);
+  VT(VT_begin, vtWaitSym);
+  TRACE_SCOPE("sync", "deferred");
+  (void)Service::run().get();
+  VT(VT_end, vtWaitSym);
+}
+
+// users currently need to call fini to make MPI terminate gracefully
+void fini() {
+  if (finied)
+    return;
+  sync_promises();
+  {
+    auto guids = Registry::get_all();
+    for (auto id : guids) {
+      Service::drop(id);
+    }
+  }
+  sync_promises();
+  fini_mediator(); // stop task is sent in here
+  if (pprocessor) {
+    if (getTransceiver()->nranks() == 1)
+      defer(nullptr);
+    pprocessor->join();
+    delete pprocessor;
+    pprocessor = nullptr;
+  }
+  trace::write(); // needs the transceiver
+  comm::write();
+  jit::timing::write(myrank());
+  jit::roofline::write(myrank());
+  fini_transceiver();
+  Deferred::fini();
+  Registry::fini();
+  jit::fini();
+  inited = false;
+  finied = true;
+}
+
+void init(bool cw, const std::string &libidtr) {
+  if (inited)
+    return;
+
+  if (!std::ifstream(libidtr)) {
+    throw std::runtime_error(std::string("Cannot find libidtr.so"));
+  }
+
+  init_transceiver(new MPITransceiver(cw));
+  init_mediator(new MPIMediator());
+  int cpu = sched_getcpu();
+  std::cerr << "rank " << getTransceiver()->rank() << " is running on core "
+            << cpu << std::endl;
+  if (cw) {
+    if (getTransceiver()->rank()) {
+      process_promises(libidtr);
+      fini();
+      exit(0);
+    }
+  }
+  trace::set_thread_name("main");
+  pprocessor = new std::thread(process_promises, libidtr);
+  inited = true;
+  finied = false;
+}
+} // namespace SHARPY
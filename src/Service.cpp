@@ -29,9 +29,11 @@ struct DeferredService : public DeferredT<Service::service_promise_type,
 
   id_type _a;
   Op _op;
+  const char *_cause = "sync"; // not serialized
 
   DeferredService(Op op = SERVICE_LAST) : _a(), _op(op) {}
   DeferredService(Op op, id_type id) : _a(id), _op(op) {}
+  DeferredService(Op op, const char *cause) : _a(), _op(op), _cause(cause) {}
 
   void run() override {
     switch (_op) {
@@ -65,6 +67,7 @@ struct DeferredService : public DeferredT<Service::service_promise_type,
   }
 
   FactoryId factory() const override { return F_SERVICE; }
+  const char *flush_cause() const override { return _cause; }
 
   template <typename S> void serialize(S &ser) {
     ser.template value<sizeof(_a)>(_a);
@@ -110,8 +113,9 @@ void Service::drop(const id_type a) {
   }
 }
 
-Service::service_future_type Service::run() {
-  return defer<DeferredService>(DeferredService::RUN);
+Service::service_future_type Service::run(const char *cause) {
+  Loop::check_sync();
+  return defer<DeferredService>(DeferredService::RUN, cause);
 }
 
 FutureArray *Service::replicate(const FutureArray &a) {
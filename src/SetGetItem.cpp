@@ -29,6 +29,8 @@
 #include <pybind11/pybind11.h>
 namespace py = pybind11;
 
+#include <limits>
+
 namespace SHARPY {
 
 template <typename T> struct mk_array {
@@ -48,7 +50,11 @@ template <typename T> struct wrap_array {
   }
 };
 
-py::handle wrap(NDArray::ptr_type tnsr, const py::handle &handle) {
+// Create a numpy array viewing the local data of tnsr (no copy).
+// The numpy array's base is a capsule holding a reference to tnsr, e.g. the
+// local data (and for views the array it was sliced from) stays alive as long
+// as the numpy array or any view of it lives.
+py::handle wrap(NDArray::ptr_type tnsr) {
   auto tmp_shp = tnsr->local_shape();
   auto tmp_str = tnsr->local_strides();
   auto nd = tnsr->ndims();
@@ -56,14 +62,18 @@ py::handle wrap(NDArray::ptr_type tnsr, const py::handle &handle) {
   std::vector<ssize_t> strides(nd);
   for (auto i = 0; i < nd; ++i) {
     strides[i] = eSz * tmp_str[i];
-    if (strides[i] / tmp_str[i] != eSz) {
+    // broadcasted dimensions have stride 0
+    if (tmp_str[i] && strides[i] / tmp_str[i] != eSz) {
       throw std::overflow_error("Fatal: Integer overflow.");
     }
   }
 
+  auto owner = py::capsule(new NDArray::ptr_type(tnsr), [](void *p) {
+    delete static_cast<NDArray::ptr_type *>(p);
+  });
   return dispatch<wrap_array>(tnsr->dtype(),
                               std::vector<ssize_t>(tmp_shp, &tmp_shp[nd]),
-                              strides, tnsr->data(), handle);
+                              strides, tnsr->data(), owner);
 }
 
 // ***************************************************************************
@@ -71,18 +81,9 @@ py::handle wrap(NDArray::ptr_type tnsr, const py::handle &handle) {
 struct DeferredGetLocals
     : public DeferredT<GetItem::py_promise_type, GetItem::py_future_type> {
   id_type _a;
-  py::handle _handle;
 
   DeferredGetLocals() = default;
-  DeferredGetLocals(const array_i::future_type &a, py::handle &handle)
-      : _a(a.guid()), _handle(handle) {
-    py::gil_scoped_acquire acquire;
-    _handle.inc_ref();
-  }
-  ~DeferredGetLocals() {
-    py::gil_scoped_acquire acquire;
-    _handle.dec_ref();
-  }
+  DeferredGetLocals(const array_i::future_type &a) : _a(a.guid()) {}
 
   void run() override {
     auto aa = std::move(Registry::get(_a).get());
@@ -90,7 +91,7 @@ struct DeferredGetLocals
     if (!a_ptr) {
       throw std::invalid_argument("Expected NDArray in getlocals.");
     }
-    auto res = wrap(a_ptr, _handle);
+    auto res = wrap(a_ptr);
     auto tpl = py::make_tuple(py::reinterpret_steal<py::object>(res));
     set_value(tpl.release());
   }
@@ -136,6 +137,9 @@ struct DeferredGather
     if (!sendonly || !trscvr) {
       std::vector<ssize_t> shp(a_ptr->shape());
       res = dispatch<mk_array>(a_ptr->dtype(), std::move(shp), outPtr);
+    } else {
+      // non-root processes do not get any data
+      res = py::none().release();
     }
 
     gather_array(a_ptr, _root, outPtr);
@@ -152,6 +156,104 @@ struct DeferredGather
 
   template <typename S> void serialize(S &ser) {
     ser.template value<sizeof(_a)>(_a);
+    ser.template value<sizeof(_root)>(_root);
+  }
+};
+
+// ***************************************************************************
+
+/// @brief gather array in slabs of consecutive rows (first dimension) and
+/// pass each slab to a Python callable on root. At no point more than one slab
+/// is held in a temporary buffer.
+struct DeferredGatherChunks
+    : public DeferredT<GetItem::py_promise_type, GetItem::py_future_type> {
+  id_type _a;
+  uint64_t _chunkBytes;
+  rank_type _root;
+  py::object _callback;
+
+  DeferredGatherChunks() = default;
+  DeferredGatherChunks(const array_i::future_type &a, py::object &callback,
+                       uint64_t chunkBytes, rank_type root)
+      : _a(a.guid()), _chunkBytes(chunkBytes), _root(root),
+        _callback(callback) {}
+
+  void run() override {
+    auto aa = std::move(Registry::get(_a).get());
+    auto a_ptr = std::dynamic_pointer_cast<NDArray>(aa);
+    if (!a_ptr) {
+      throw std::invalid_argument("Expected NDArray in gather.");
+    }
+    auto trscvr = a_ptr->transceiver();
+    auto myrank = trscvr ? trscvr->rank() : 0;
+    bool recv = !trscvr || _root == REPLICATED || _root == myrank;
+    auto dtype = a_ptr->dtype();
+    const auto &gShape = a_ptr->shape();
+    auto nd = a_ptr->ndims();
+
+    // a failing callback must not stop us from participating in the remaining
+    // collectives; we keep the first error and report it at the end
+    std::string error;
+    auto deliver = [&](int64_t start, py::handle slab) {
+      auto obj = py::reinterpret_steal<py::object>(slab);
+      if (!recv || !error.empty())
+        return;
+      try {
+        _callback(start, obj);
+      } catch (py::error_already_set &e) {
+        error = e.what();
+      }
+    };
+
+    if (nd == 0) {
+      void *outPtr = nullptr;
+      py::handle res;
+      if (recv) {
+        res = dispatch<mk_array>(dtype, std::vector<ssize_t>(), outPtr);
+      }
+      gather_array(a_ptr, _root, outPtr);
+      deliver(0, res);
+    } else {
+      int64_t rowSz = std::accumulate(gShape.begin() + 1, gShape.end(),
+                                      sizeof_dtype(dtype),
+                                      std::multiplies<int64_t>());
+      int64_t nRows = std::max<int64_t>(
+          1, static_cast<int64_t>(_chunkBytes) / std::max<int64_t>(rowSz, 1));
+      auto parts = gather_partitions(a_ptr);
+
+      for (int64_t start = 0; start < gShape[0]; start += nRows) {
+        auto end = std::min(start + nRows, gShape[0]);
+        void *outPtr = nullptr;
+        py::handle res;
+        if (recv) {
+          std::vector<ssize_t> shp(gShape.begin(), gShape.end());
+          shp[0] = end - start;
+          res = dispatch<mk_array>(dtype, std::move(shp), outPtr);
+        }
+        gather_rows(a_ptr, parts, start, end, _root, outPtr);
+        deliver(start, res);
+      }
+    }
+
+    if (error.empty()) {
+      set_value(py::none().release());
+    } else {
+      set_exception(std::make_exception_ptr(std::runtime_error(error)));
+    }
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_GATHERCHUNKS; }
+
+  template <typename S> void serialize(S &ser) {
+    throw std::runtime_error("Not implemented");
+    ser.template value<sizeof(_a)>(_a);
+    ser.template value<sizeof(_chunkBytes)>(_chunkBytes);
+    ser.template value<sizeof(_root)>(_root);
   }
 };
 
@@ -256,6 +358,378 @@ struct DeferredMap : public Deferred {
 
 // ***************************************************************************
 
+template <typename T> struct cast_array {
+  static py::object op(const py::object &b) {
+    return py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(
+        b);
+  }
+};
+
+// copy a box of counts[d..nd[ elements between two strided buffers
+template <typename T>
+static void copy_box(uint64_t d, uint64_t nd, T *dst,
+                     const int64_t *dstStrides, const T *src,
+                     const int64_t *srcStrides, const int64_t *counts) {
+  for (int64_t i = 0; i < counts[d]; ++i) {
+    if (d == nd - 1) {
+      dst[i * dstStrides[d]] = src[i * srcStrides[d]];
+    } else {
+      copy_box(d + 1, nd, dst + i * dstStrides[d], dstStrides,
+               src + i * srcStrides[d], srcStrides, counts);
+    }
+  }
+}
+
+// @return row-major strides (in elements) of an array with given shape
+static std::vector<int64_t> c_strides(const int64_t *shape, uint64_t nd) {
+  std::vector<int64_t> strides(nd, 1);
+  for (int64_t i = static_cast<int64_t>(nd) - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * shape[i + 1];
+  }
+  return strides;
+}
+
+/// @brief copy a numpy array into a slice of a distributed array.
+/// The numpy array is either replicated on all processes or held by root
+/// only. Every process copies only the part overlapping its local partition;
+/// if held by root, root scatters only these parts.
+struct DeferredSetItemNumpy : public Deferred {
+  id_type _a;
+  NDSlice _slc;
+  py::object _npa; // None if not root
+  rank_type _root;
+
+  DeferredSetItemNumpy() = default;
+  DeferredSetItemNumpy(const array_i::future_type &a,
+                       const std::vector<py::slice> &v, py::object npa,
+                       rank_type root)
+      : Deferred(a.dtype(), a.shape(), a.device(), a.team(), a.guid()),
+        _a(a.guid()), _slc(v, a.shape()), _npa(npa), _root(root) {}
+
+  void run() override {
+    auto aa = std::move(Registry::get(_a).get());
+    auto a_ptr = std::dynamic_pointer_cast<NDArray>(aa);
+    if (!a_ptr) {
+      throw std::invalid_argument("Expected NDArray in setitem.");
+    }
+    uint64_t nd = a_ptr->ndims();
+    auto trscvr = a_ptr->transceiver();
+    auto lOffs = a_ptr->local_offsets();
+    auto lShape = a_ptr->local_shape();
+    auto lStrides = a_ptr->local_strides();
+    const auto &offs = _slc.offsets();
+    const auto &sizes = _slc.sizes();
+    const auto &steps = _slc.strides();
+
+    // determine which elements of the slice (box of slice-indices) are local
+    // [kLo, kLo+cnt[ per dimension
+    std::vector<int64_t> myBox(2 * nd);
+    int64_t *kLo = myBox.data();
+    int64_t *cnt = myBox.data() + nd;
+    int64_t dstOff = 0;
+    std::vector<int64_t> dstStrides(nd);
+    for (auto d = 0ul; d < nd; ++d) {
+      auto lo = lOffs.empty() ? 0 : lOffs[d];
+      auto hi = lo + lShape[d];
+      auto first =
+          offs[d] >= lo ? 0 : (lo - offs[d] + steps[d] - 1) / steps[d];
+      auto last = offs[d] >= hi ? 0 : (hi - offs[d] + steps[d] - 1) / steps[d];
+      kLo[d] = std::min(first, sizes[d]);
+      cnt[d] = std::max<int64_t>(0, std::min(last, sizes[d]) - kLo[d]);
+      dstOff += (offs[d] + kLo[d] * steps[d] - lo) * lStrides[d];
+      dstStrides[d] = lStrides[d] * steps[d];
+    }
+    auto myCnt = std::accumulate(cnt, cnt + nd, int64_t(1),
+                                 std::multiplies<int64_t>());
+    auto srcStrides = c_strides(sizes.data(), nd);
+
+    bool scatter = trscvr && _root != REPLICATED && trscvr->nranks() > 1;
+    auto myrank = trscvr ? trscvr->rank() : 0;
+    bool hasSrc = !scatter || _root == myrank;
+
+    dispatch(a_ptr->dtype(), a_ptr->data(), [&](auto *ptr) {
+      using T = std::remove_pointer_t<decltype(ptr)>;
+      const T *src = nullptr;
+      if (hasSrc) {
+        src = static_cast<const T *>(py::array(_npa).data());
+      }
+
+      if (scatter && nd == 0) {
+        // a single element, simply broadcast it
+        if (hasSrc) {
+          *ptr = *src;
+        }
+        trscvr->bcast(ptr, sizeof(T), _root);
+        return;
+      }
+
+      if (scatter) {
+        auto nranks = trscvr->nranks();
+        // root needs to know what to send where
+        std::vector<int64_t> boxes(_root == myrank ? 2 * nd * nranks : 0);
+        std::vector<int> counts(nranks, static_cast<int>(2 * nd));
+        std::vector<int> displacements(nranks);
+        for (auto i = 0ul; i < nranks; ++i) {
+          displacements[i] = i * 2 * nd;
+        }
+        int64_t *boxPtr = myBox.data();
+        if (_root == myrank) {
+          std::copy(myBox.begin(), myBox.end(), &boxes[2 * nd * myrank]);
+          boxPtr = boxes.data();
+        }
+        trscvr->gather(boxPtr, counts.data(), displacements.data(), INT64,
+                       _root);
+
+        // root packs each process' part, all others receive theirs
+        std::vector<T> buff;
+        if (_root == myrank) {
+          int64_t total = 0;
+          for (auto i = 0ul; i < nranks; ++i) {
+            auto rCnt = &boxes[2 * nd * i + nd];
+            int64_t n =
+                i == myrank ? 0
+                            : std::accumulate(rCnt, rCnt + nd, int64_t(1),
+                                              std::multiplies<int64_t>());
+            if (total + n > std::numeric_limits<int>::max()) {
+              throw std::overflow_error("Slice too large for scatter.");
+            }
+            counts[i] = n;
+            displacements[i] = total;
+            total += n;
+          }
+          buff.resize(total);
+          for (auto i = 0ul; i < nranks; ++i) {
+            if (counts[i] == 0)
+              continue;
+            auto rLo = &boxes[2 * nd * i];
+            auto rCnt = rLo + nd;
+            auto packStrides = c_strides(rCnt, nd);
+            int64_t srcOff = 0;
+            for (auto d = 0ul; d < nd; ++d) {
+              srcOff += rLo[d] * srcStrides[d];
+            }
+            copy_box(0, nd, &buff[displacements[i]], packStrides.data(),
+                     src + srcOff, srcStrides.data(), rCnt);
+          }
+        } else {
+          if (myCnt > std::numeric_limits<int>::max()) {
+            throw std::overflow_error("Slice too large for scatter.");
+          }
+          counts[myrank] = myCnt;
+          buff.resize(myCnt);
+        }
+        trscvr->scatter(buff.data(), counts.data(), displacements.data(),
+                        a_ptr->dtype(), _root);
+
+        if (_root != myrank && myCnt > 0) {
+          auto unpackStrides = c_strides(cnt, nd);
+          copy_box(0, nd, ptr + dstOff, dstStrides.data(), buff.data(),
+                   unpackStrides.data(), cnt);
+        }
+      }
+
+      // local copy from source held by this process
+      if (hasSrc && myCnt > 0) {
+        if (nd == 0) {
+          *ptr = *src;
+        } else {
+          int64_t srcOff = 0;
+          for (auto d = 0ul; d < nd; ++d) {
+            srcOff += kLo[d] * srcStrides[d];
+          }
+          copy_box(0, nd, ptr + dstOff, dstStrides.data(), src + srcOff,
+                   srcStrides.data(), cnt);
+        }
+      }
+    });
+
+    this->set_value(aa);
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_SETITEMNUMPY; }
+
+  template <typename S> void serialize(S &ser) {
+    throw std::runtime_error("Not implemented");
+    ser.template value<sizeof(_a)>(_a);
+    ser.template object(_slc);
+    ser.template value<sizeof(_root)>(_root);
+  }
+};
+
+// ***************************************************************************
+
+// @return offset of global index idx in local data of a_ptr, -1 if not local
+static int64_t local_index(const NDArray::ptr_type &a_ptr,
+                           const std::vector<int64_t> &idx) {
+  auto lOffs = a_ptr->local_offsets();
+  auto lShape = a_ptr->local_shape();
+  auto lStrides = a_ptr->local_strides();
+  int64_t off = 0;
+  for (auto d = 0ul; d < idx.size(); ++d) {
+    auto l = idx[d] - (lOffs.empty() ? 0 : lOffs[d]);
+    if (l < 0 || l >= lShape[d]) {
+      return -1;
+    }
+    off += l * lStrides[d];
+  }
+  return off;
+}
+
+/// @brief read a single element. The owning process reads it from its local
+/// data and shares it in a single reduction, no 0d array and no replication
+/// is involved.
+struct DeferredItem
+    : public DeferredT<GetItem::py_promise_type, GetItem::py_future_type> {
+  id_type _a;
+  std::vector<int64_t> _idx;
+
+  DeferredItem() = default;
+  DeferredItem(const array_i::future_type &a, std::vector<int64_t> &&idx)
+      : _a(a.guid()), _idx(std::move(idx)) {}
+
+  void run() override {
+    auto aa = std::move(Registry::get(_a).get());
+    auto a_ptr = std::dynamic_pointer_cast<NDArray>(aa);
+    if (!a_ptr) {
+      throw std::invalid_argument("Expected NDArray in item.");
+    }
+    auto trscvr = a_ptr->transceiver();
+    bool dist =
+        trscvr && trscvr->nranks() > 1 && !a_ptr->is_replicated();
+    auto off = local_index(a_ptr, _idx);
+
+    dispatch(a_ptr->dtype(), a_ptr->data(), [&](auto *ptr) {
+      using T = std::remove_pointer_t<decltype(ptr)>;
+      T val{};
+      if (off >= 0) {
+        val = ptr[off];
+      }
+      if (dist) {
+        // Other processes' partitions are not known here (they can be
+        // irregular), but they are disjoint: the owner contributes the bits
+        // of the value, everybody else zeros. One reduction yields the
+        // value and the number of owners.
+        constexpr size_t W = (sizeof(T) + sizeof(uint64_t) - 1) /
+                             sizeof(uint64_t);
+        uint64_t buff[1 + W] = {};
+        if (off >= 0) {
+          buff[0] = 1;
+          memcpy(&buff[1], &val, sizeof(T));
+        }
+        trscvr->reduce_all(buff, UINT64, 1 + W, SUM);
+        if (buff[0] > 1) {
+          set_exception(std::make_exception_ptr(std::runtime_error(
+              "Internal error: element owned by several processes.")));
+          return;
+        }
+        if (buff[0] == 1) {
+          memcpy(&val, &buff[1], sizeof(T));
+          off = 0;
+        }
+      }
+      if (off < 0) {
+        set_exception(std::make_exception_ptr(
+            std::out_of_range("Index not found in array data.")));
+      } else {
+        set_value(py::cast(val).release());
+      }
+    });
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_ITEM; }
+
+  template <typename S> void serialize(S &ser) {
+    ser.template value<sizeof(_a)>(_a);
+    ser.template container<sizeof(int64_t)>(_idx, 8);
+  }
+};
+
+/// @brief write a single element. Only the owning process(es) write, no
+/// communication and no MLIR involved.
+/// The value was converted to the element type by the caller, run() cannot
+/// fail on it.
+struct DeferredItemSet : public Deferred {
+  id_type _a;
+  std::vector<int64_t> _idx;
+  uint64_t _val; // bits of the element
+
+  DeferredItemSet() = default;
+  DeferredItemSet(const array_i::future_type &a, std::vector<int64_t> &&idx,
+                  uint64_t val)
+      : Deferred(a.dtype(), a.shape(), a.device(), a.team(), a.guid()),
+        _a(a.guid()), _idx(std::move(idx)), _val(val) {}
+
+  void run() override {
+    auto aa = std::move(Registry::get(_a).get());
+    auto a_ptr = std::dynamic_pointer_cast<NDArray>(aa);
+    if (!a_ptr) {
+      throw std::invalid_argument("Expected NDArray in itemset.");
+    }
+    auto off = local_index(a_ptr, _idx);
+    if (off >= 0) {
+      dispatch(a_ptr->dtype(), a_ptr->data(), [&](auto *ptr) {
+        memcpy(ptr + off, &_val, sizeof(*ptr));
+      });
+    }
+    this->set_value(aa);
+  }
+
+  bool generate_mlir(::mlir::OpBuilder &builder, const ::mlir::Location &loc,
+                     jit::DepManager &dm) override {
+    return true;
+  }
+
+  FactoryId factory() const override { return F_ITEMSET; }
+
+  template <typename S> void serialize(S &ser) {
+    throw std::runtime_error("Not implemented");
+    ser.template value<sizeof(_a)>(_a);
+    ser.template container<sizeof(int64_t)>(_idx, 8);
+    ser.template value<sizeof(_val)>(_val);
+  }
+};
+
+// normalize and check index of a single element
+static std::vector<int64_t> normalize_index(const shape_type &shape,
+                                            const std::vector<int64_t> &idx) {
+  auto nd = shape.size();
+  if (idx.empty() && nd > 0) {
+    if (VPROD(shape) != 1) {
+      throw std::invalid_argument(
+          "can only convert an array of size 1 to a Python scalar");
+    }
+    return std::vector<int64_t>(nd, 0);
+  }
+  if (idx.size() != nd) {
+    throw std::invalid_argument("incorrect number of indices for array");
+  }
+  std::vector<int64_t> res(idx);
+  for (auto d = 0ul; d < nd; ++d) {
+    if (res[d] < 0) {
+      res[d] += shape[d];
+    }
+    if (res[d] < 0 || res[d] >= shape[d]) {
+      std::stringstream msg;
+      msg << "index " << idx[d] << " is out of bounds for axis " << d
+          << " with size " << shape[d] << "\n";
+      throw std::out_of_range(msg.str());
+    }
+  }
+  return res;
+}
+
+// ***************************************************************************
+
 struct DeferredGetItem : public Deferred {
   id_type _a;
   NDSlice _slc;
@@ -352,18 +826,33 @@ FutureArray *GetItem::__getitem__(const FutureArray &a,
   return new FutureArray(defer<DeferredGetItem>(afut, std::move(slc)));
 }
 
-GetItem::py_future_type GetItem::get_locals(const FutureArray &a,
-                                            py::handle h) {
-  return defer<DeferredGetLocals>(a.get(), h);
+GetItem::py_future_type GetItem::get_locals(const FutureArray &a) {
+  return defer<DeferredGetLocals>(a.get());
 }
 
 GetItem::py_future_type GetItem::gather(const FutureArray &a, rank_type root) {
   return defer<DeferredGather>(a.get(), root);
 }
 
+GetItem::py_future_type GetItem::gather_chunks(const FutureArray &a,
+                                               py::object &callback,
+                                               uint64_t chunkBytes,
+                                               rank_type root) {
+  return defer<DeferredGatherChunks>(a.get(), callback, chunkBytes, root);
+}
+
+GetItem::py_future_type GetItem::item(const FutureArray &a,
+                                      const std::vector<int64_t> &idx) {
+  auto afut = a.get();
+  return defer<DeferredItem>(afut, normalize_index(afut.shape(), idx));
+}
+
 FutureArray *SetItem::__setitem__(FutureArray &a,
                                   const std::vector<py::slice> &v,
                                   const py::object &b) {
+  if (py::isinstance<py::array>(b)) {
+    return set_from_numpy(a, v, b, REPLICATED);
+  }
   auto afut = a.get();
   validateSlice(afut.shape(), v);
   auto bb = Creator::mk_future(b, afut.device(), afut.team(), afut.dtype());
@@ -373,6 +862,65 @@ FutureArray *SetItem::__setitem__(FutureArray &a,
   return &a;
 }
 
+FutureArray *SetItem::set_from_numpy(FutureArray &a,
+                                     const std::vector<py::slice> &v,
+                                     const py::object &b, rank_type root) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error(
+        "Assigning numpy arrays is not supported in c/w mode.");
+  }
+  auto afut = a.get();
+  auto nd = afut.rank();
+  if (v.size() > static_cast<size_t>(nd)) {
+    throw std::out_of_range("Too many indices for array");
+  }
+  // missing trailing dimensions select the full range
+  auto slcs = v;
+  while (slcs.size() < static_cast<size_t>(nd)) {
+    slcs.emplace_back(py::reinterpret_steal<py::slice>(
+        PySlice_New(nullptr, nullptr, nullptr)));
+  }
+  validateSlice(afut.shape(), slcs);
+
+  auto myrank = getTransceiver()->rank();
+  py::object npa = py::none();
+  if (root == REPLICATED || root == myrank) {
+    npa = dispatch<cast_array>(afut.dtype(), b);
+    if (!npa) {
+      throw std::invalid_argument("Cannot convert value to array of "
+                                  "matching dtype in setitem.");
+    }
+    NDSlice slc(slcs, afut.shape());
+    if (py::array(npa).size() != static_cast<ssize_t>(slc.size())) {
+      throw std::invalid_argument("Mismatching number of elements in setitem");
+    }
+  }
+  a.put(defer<DeferredSetItemNumpy>(afut, slcs, npa, root));
+  return &a;
+}
+
+FutureArray *SetItem::itemset(FutureArray &a, const std::vector<int64_t> &idx,
+                              const py::object &b) {
+  auto afut = a.get();
+  auto nidx = normalize_index(afut.shape(), idx);
+  // convert here, errors on the worker thread cannot be reported
+  if (b.is_none()) {
+    throw std::invalid_argument("Cannot assign None to an array element.");
+  }
+  uint64_t val = 0;
+  dispatch(afut.dtype(), &val, [&](auto *ptr) {
+    try {
+      *ptr = b.cast<std::remove_pointer_t<decltype(ptr)>>();
+    } catch (py::cast_error &) {
+      throw std::invalid_argument("Cannot convert " +
+                                  py::repr(b).cast<std::string>() +
+                                  " to the element type of the array.");
+    }
+  });
+  a.put(defer<DeferredItemSet>(afut, std::move(nidx), val));
+  return &a;
+}
+
 FutureArray *SetItem::map(FutureArray &a, py::object &b) {
   a.put(defer<DeferredMap>(a.get(), b));
   return &a;
@@ -386,7 +934,11 @@ py::object GetItem::get_slice(const FutureArray &a,
 
 FACTORY_INIT(DeferredGetItem, F_GETITEM);
 FACTORY_INIT(DeferredSetItem, F_SETITEM);
+FACTORY_INIT(DeferredSetItemNumpy, F_SETITEMNUMPY);
 FACTORY_INIT(DeferredMap, F_MAP);
+FACTORY_INIT(DeferredItem, F_ITEM);
+FACTORY_INIT(DeferredItemSet, F_ITEMSET);
 FACTORY_INIT(DeferredGather, F_GATHER);
+FACTORY_INIT(DeferredGatherChunks, F_GATHERCHUNKS);
 FACTORY_INIT(DeferredGetLocals, F_GETLOCALS);
 } // namespace SHARPY
@@ -0,0 +1,60 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Runtime statistics (see Stats.hpp).
+*/
+
+#include "sharpy/Stats.hpp"
+
+namespace SHARPY {
+namespace stats {
+
+std::atomic<uint64_t> _counters[COUNTER_LAST] = {};
+
+const char *name(Counter c) {
+  switch (c) {
+  case DEFERRED_OPS:
+    return "deferred_ops";
+  case COMPILES:
+    return "compiles";
+  case COMPILE_NS:
+    return "compile_ns";
+  case CACHE_HITS:
+    return "cache_hits";
+  case CACHE_MISSES:
+    return "cache_misses";
+  case KERNELS:
+    return "kernels";
+  case KERNEL_NS:
+    return "kernel_ns";
+  case HALO_UPDATES:
+    return "halo_updates";
+  case HALO_BYTES:
+    return "halo_bytes";
+  case RESHAPES:
+    return "reshapes";
+  case RESHAPE_BYTES:
+    return "reshape_bytes";
+  case REDUCTIONS:
+    return "reductions";
+  case REDUCTION_BYTES:
+    return "reduction_bytes";
+  case EST_FLOPS:
+    return "est_flops";
+  case EST_BYTES:
+    return "est_bytes";
+  case CACHED_ENGINES:
+    return "cached_engines";
+  default:
+    return "unknown";
+  }
+}
+
+void reset() {
+  for (int c = 0; c < CACHED_ENGINES; ++c) {
+    _counters[c].store(0, std::memory_order_relaxed);
+  }
+}
+
+} // namespace stats
+} // namespace SHARPY
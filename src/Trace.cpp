@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Built-in timeline tracing (see Trace.hpp).
+*/
+
+#include "sharpy/Trace.hpp"
+#include "sharpy/Transceiver.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SHARPY {
+namespace trace {
+
+static const std::string prefix =
+    get_prefix_env("SHARPY_TRACE", "sharpy_trace");
+bool _enabled = !prefix.empty();
+static const size_t capacity =
+    std::max(get_int_env("SHARPY_TRACE_EVENTS", 1 << 18), 1);
+
+constexpr uint64_t INSTANT = std::numeric_limits<uint64_t>::max();
+
+struct Event {
+  const char *_name;
+  const char *_cat;
+  uint64_t _begin;
+  uint64_t _dur; // INSTANT for instant events
+};
+
+/// @brief events of a single thread, the oldest get overwritten when full
+struct Buffer {
+  std::vector<Event> _events;
+  uint64_t _n = 0; // number of events recorded so far
+  int _tid;
+  std::string _name;
+
+  Buffer(int tid) : _events(capacity), _tid(tid) {}
+};
+
+// buffers of all threads, never freed: threads may exit before we write
+static std::mutex buffersMutex;
+static std::vector<std::unique_ptr<Buffer>> buffers;
+static thread_local Buffer *threadBuffer = nullptr;
+
+static Buffer &buffer() {
+  if (!threadBuffer) {
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    buffers.emplace_back(std::make_unique<Buffer>(buffers.size()));
+    threadBuffer = buffers.back().get();
+  }
+  return *threadBuffer;
+}
+
+static void record(const char *name, const char *cat, uint64_t begin,
+                   uint64_t dur) {
+  auto &b = buffer();
+  b._events[b._n++ % capacity] = {name, cat, begin, dur};
+}
+
+uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void complete(const char *name, const char *cat, uint64_t begin) {
+  if (_enabled) {
+    record(name, cat, begin, now() - begin);
+  }
+}
+
+void instant(const char *name, const char *cat) {
+  if (_enabled) {
+    record(name, cat, now(), INSTANT);
+  }
+}
+
+void set_thread_name(const char *name) {
+  if (_enabled) {
+    buffer()._name = name;
+  }
+}
+
+// print ns as us with 3 decimals, the unit Chrome expects
+static void print_us(std::ostream &os, uint64_t ns) {
+  os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+void write() {
+  if (!_enabled) {
+    return;
+  }
+  auto tc = getTransceiver();
+  auto rank = tc ? tc->rank() : 0;
+  auto fname = prefix + "." + std::to_string(rank) + ".json";
+  std::ofstream os(fname);
+  if (!os) {
+    std::cerr << "sharpy: cannot write trace " << fname << std::endl;
+    return;
+  }
+
+  // wall-clock time is what aligns traces of different ranks
+  auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::system_clock::now().time_since_epoch())
+                  .count();
+  uint64_t offset = static_cast<uint64_t>(wall) - now();
+
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  os << "{\"otherData\":{\"rank\":" << rank
+     << ",\"nranks\":" << (tc ? tc->nranks() : 1) << "},\n"
+     << "\"traceEvents\":[\n"
+     << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << rank
+     << ",\"args\":{\"name\":\"rank " << rank << "\"}},\n"
+     << "{\"ph\":\"M\",\"name\":\"process_sort_index\",\"pid\":" << rank
+     << ",\"args\":{\"sort_index\":" << rank << "}}";
+  uint64_t dropped = 0;
+  for (auto &b : buffers) {
+    auto name = b->_name.empty() ? "thread " + std::to_string(b->_tid)
+                                 : b->_name;
+    os << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << rank
+       << ",\"tid\":" << b->_tid << ",\"args\":{\"name\":\"" << name
+       << "\"}}";
+    auto n = std::min<uint64_t>(b->_n, capacity);
+    dropped += b->_n - n;
+    for (auto i = b->_n - n; i < b->_n; ++i) {
+      auto &e = b->_events[i % capacity];
+      os << ",\n{\"name\":\"" << e._name << "\",\"cat\":\"" << e._cat
+         << "\",\"pid\":" << rank << ",\"tid\":" << b->_tid << ",\"ts\":";
+      print_us(os, e._begin + offset);
+      if (e._dur == INSTANT) {
+        os << ",\"ph\":\"i\",\"s\":\"t\"}";
+      } else {
+        os << ",\"ph\":\"X\",\"dur\":";
+        print_us(os, e._dur);
+        os << "}";
+      }
+    }
+  }
+  os << "\n]}\n";
+  if (dropped) {
+    std::cerr << "sharpy: trace buffers overflowed, " << dropped
+              << " oldest events dropped (see SHARPY_TRACE_EVENTS)"
+              << std::endl;
+  }
+}
+
+} // namespace trace
+} // namespace SHARPY
@@ -3,14 +3,74 @@
 // the queue of deferred runables
 
 #include "include/sharpy/Deferred.hpp"
+#include "include/sharpy/FlushStats.hpp"
+#include "include/sharpy/Stats.hpp"
+#include "include/sharpy/Trace.hpp"
+#include "include/sharpy/UtilsAndTypes.hpp"
 #include <oneapi/tbb/concurrent_queue.h>
 
+#include <pybind11/pybind11.h>
+namespace py = pybind11;
+#include <frameobject.h>
+
 namespace SHARPY {
 
 // thread-safe FIFO queue holding deferred objects
 tbb::concurrent_bounded_queue<Runable::ptr_type> _deferred;
 
+static const bool srcLocs = get_bool_env("SHARPY_LOCATIONS");
+bool use_src_locs() { return srcLocs; }
+
+// directory of the sharpy package, its frames are not user code
+static const std::string &pkgDir() {
+  static const std::string dir = []() -> std::string {
+    try {
+      auto f = py::module_::import("sharpy").attr("__file__");
+      auto file = f.cast<std::string>();
+      return file.substr(0, file.rfind('/') + 1);
+    } catch (py::error_already_set &) {
+      return {}; // e.g. used through the C++ API
+    }
+  }();
+  return dir;
+}
+
+// the innermost Python frame outside of sharpy, if any
+static std::unique_ptr<SrcLoc> pyCaller() {
+  if (!Py_IsInitialized() || !PyGILState_Check()) {
+    return {};
+  }
+  auto &skip = pkgDir();
+  auto frame = py::reinterpret_steal<py::object>(reinterpret_cast<PyObject *>(
+      PyThreadState_GetFrame(PyThreadState_Get())));
+  while (frame) {
+    auto f = reinterpret_cast<PyFrameObject *>(frame.ptr());
+    auto code = py::reinterpret_steal<py::object>(
+        reinterpret_cast<PyObject *>(PyFrame_GetCode(f)));
+    auto c = reinterpret_cast<PyCodeObject *>(code.ptr());
+    auto file = py::handle(c->co_filename).cast<std::string>();
+    if (skip.empty() || file.compare(0, skip.size(), skip) != 0) {
+      return std::make_unique<SrcLoc>(
+          SrcLoc{std::move(file), py::handle(c->co_name).cast<std::string>(),
+                 PyFrame_GetLineNumber(f)});
+    }
+    frame = py::reinterpret_steal<py::object>(
+        reinterpret_cast<PyObject *>(PyFrame_GetBack(f)));
+  }
+  return {};
+}
+
 // add a deferred object to the queue
-void push_runable(Runable::ptr_type &&r) { _deferred.push(std::move(r)); }
+void push_runable(Runable::ptr_type &&r) {
+  trace::instant("defer", "deferred");
+  if (r && !r->isDeleter()) {
+    stats::add(stats::DEFERRED_OPS);
+  }
+  static const bool capture = flushes::capture_sites();
+  if (capture && r && !r->_srcLoc) {
+    r->_srcLoc = pyCaller();
+  }
+  _deferred.push(std::move(r));
+}
 
 } // namespace SHARPY
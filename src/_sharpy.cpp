@@ -18,8 +18,10 @@
 
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
-#include <sched.h>
+#include <algorithm>
+#include <chrono>
 #include <stdlib.h>
+#include <unordered_map>
 namespace py = pybind11;
 using namespace pybind11::literals; // to bring _a
 
@@ -30,111 +32,40 @@ using namespace pybind11::literals; // to bring _a
 #include "sharpy/EWBinOp.hpp"
 #include "sharpy/EWUnyOp.hpp"
 #include "sharpy/Factory.hpp"
+#include "sharpy/FlushStats.hpp"
 #include "sharpy/IEWBinOp.hpp"
 #include "sharpy/IO.hpp"
+#include "sharpy/JitFunc.hpp"
 #include "sharpy/LinAlgOp.hpp"
-#include "sharpy/MPIMediator.hpp"
-#include "sharpy/MPITransceiver.hpp"
+#include "sharpy/Loop.hpp"
 #include "sharpy/ManipOp.hpp"
+#include "sharpy/NDArray.hpp"
 #include "sharpy/Random.hpp"
 #include "sharpy/ReduceOp.hpp"
+#include "sharpy/Runtime.hpp"
+#include "sharpy/Registry.hpp"
 #include "sharpy/Service.hpp"
 #include "sharpy/SetGetItem.hpp"
 #include "sharpy/Sorting.hpp"
+#include "sharpy/Stats.hpp"
 #include "sharpy/itac.hpp"
 #include "sharpy/jit/mlir.hpp"
 
-#include <fstream>
-#include <iostream>
-
 namespace SHARPY {
-// #########################################################################
-// The following classes are wrappers bridging pybind11 defs to TypeDispatch
-
-rank_type myrank() { return getTransceiver()->rank(); }
-
-std::thread *pprocessor = nullptr;
-
-extern bool inited;
-extern bool finied;
-
-void sync_promises() {
-  int vtWaitSym, vtSHARPYClass;
-  VT(VT_classdef, "sharpy", &vtSHARPYClass);
-  VT(VT_funcdef, "wait", vtSHARPYClass, &vtWaitSym);
-  VT(VT_begin, vtWaitSym);
-  py::gil_scoped_release release;
-  (void)Service::run().get();
-  VT(VT_end, vtWaitSym);
-}
-
-// users currently need to call fini to make MPI terminate gracefully
-void fini() {
-  if (finied)
-    return;
-  sync_promises();
-  {
-    auto guids = Registry::get_all();
-    for (auto id : guids) {
-      Service::drop(id);
-    }
-  }
-  sync_promises();
-  py::gil_scoped_release release;
-  fini_mediator(); // stop task is sent in here
-  if (pprocessor) {
-    if (getTransceiver()->nranks() == 1)
-      defer(nullptr);
-    pprocessor->join();
-    delete pprocessor;
-    pprocessor = nullptr;
-  }
-  fini_transceiver();
-  Deferred::fini();
-  Registry::fini();
-  jit::fini();
-  inited = false;
-  finied = true;
-}
-
-void init(bool cw, const std::string &libidtr) {
-  if (inited)
-    return;
-
-  if (!std::ifstream(libidtr)) {
-    throw std::runtime_error(std::string("Cannot find libidtr.so"));
-  }
-
-  init_transceiver(new MPITransceiver(cw));
-  init_mediator(new MPIMediator());
-  int cpu = sched_getcpu();
-  std::cerr << "rank " << getTransceiver()->rank() << " is running on core "
-            << cpu << std::endl;
-  if (cw) {
-    if (getTransceiver()->rank()) {
-      process_promises(libidtr);
-      fini();
-      exit(0);
-    }
-  }
-  pprocessor = new std::thread(process_promises, libidtr);
-  inited = true;
-  finied = false;
-}
-
 // #########################################################################
 
 /// trigger compile&run and return python object
 #define PY_SYNC_RETURN(_f)                                                     \
   {                                                                            \
+    Loop::check_sync(); /* before _f defers anything */                        \
     int vtWaitSym, vtSHARPYClass;                                              \
     VT(VT_classdef, "sharpy", &vtSHARPYClass);                                 \
     VT(VT_funcdef, "wait", vtSHARPYClass, &vtWaitSym);                         \
     VT(VT_begin, vtWaitSym);                                                   \
     py::handle res;                                                            \
+    Service::run(); /* with GIL to capture the call site */                    \
     {                                                                          \
       py::gil_scoped_release release;                                          \
-      Service::run();                                                          \
       res = (_f).get();                                                        \
     }                                                                          \
     VT(VT_end, vtWaitSym);                                                     \
@@ -143,21 +74,183 @@ void init(bool cw, const std::string &libidtr) {
 
 /// trigger compile&run and return given attribute _x
 #define SYNC_RETURN(_f, _a)                                                    \
+  Loop::check_sync();                                                          \
   int vtWaitSym, vtSHARPYClass;                                                \
   VT(VT_classdef, "sharpy", &vtSHARPYClass);                                   \
   VT(VT_funcdef, "wait", vtSHARPYClass, &vtWaitSym);                           \
   VT(VT_begin, vtWaitSym);                                                     \
+  Service::run(#_a); /* with GIL to capture the call site */                  \
   py::gil_scoped_release release;                                              \
-  Service::run();                                                              \
   auto r = (_f).get().get()->_a();                                             \
   VT(VT_end, vtWaitSym);                                                       \
   return r
 
 /// Replicate sharpy/future and SYNC_RETURN attribute _a
 #define REPL_SYNC_RETURN(_f, _a)                                               \
+  Loop::check_sync();                                                          \
   auto r_ = std::unique_ptr<FutureArray>(Service::replicate(f));               \
   SYNC_RETURN(r_->get(), _a)
 
+// the Python exception to report for the current C++ exception
+static py::object current_py_exception() {
+  try {
+    throw;
+  } catch (py::error_already_set &e) {
+    return e.value();
+  } catch (const std::invalid_argument &e) {
+    return py::reinterpret_borrow<py::object>(PyExc_ValueError)(e.what());
+  } catch (const std::out_of_range &e) {
+    return py::reinterpret_borrow<py::object>(PyExc_IndexError)(e.what());
+  } catch (const std::exception &e) {
+    return py::reinterpret_borrow<py::object>(PyExc_RuntimeError)(e.what());
+  } catch (...) {
+    return py::reinterpret_borrow<py::object>(PyExc_RuntimeError)(
+        "Unknown exception in asynchronous call.");
+  }
+}
+
+/// Return a concurrent.futures.Future without waiting. Once everything
+/// deferred before is computed, the worker resolves it with what _get()
+/// returns (or the exception it throws). _get is called with the GIL held.
+template <typename G> static py::object async_return(G &&_get) {
+  auto pyfut = py::module_::import("concurrent.futures").attr("Future")();
+  // we cannot cancel deferred computation
+  pyfut.attr("set_running_or_notify_cancel")();
+  defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+               [pyfut, get = std::move(_get)]() {
+                 py::object res, exc;
+                 try {
+                   res = get();
+                 } catch (...) {
+                   exc = current_py_exception();
+                 }
+                 try {
+                   if (exc) {
+                     pyfut.attr("set_exception")(exc);
+                   } else {
+                     pyfut.attr("set_result")(res);
+                   }
+                 } catch (py::error_already_set &e) {
+                   // e.g. raised by a done-callback
+                   e.discard_as_unraisable("sharpy async_return");
+                 }
+               },
+               "async");
+  {
+    py::gil_scoped_release release;
+    Service::run();
+  }
+  return pyfut;
+}
+
+/// async_return for py future _f
+#define PY_ASYNC_RETURN(_f)                                                    \
+  Loop::check_sync();                                                          \
+  return async_return([fut_ = (_f)]() {                                        \
+    return py::reinterpret_steal<py::object>(fut_.get());                      \
+  })
+
+/// Replicate sharpy/future and async_return attribute _a
+#define REPL_ASYNC_RETURN(_f, _a)                                              \
+  Loop::check_sync();                                                          \
+  auto r_ = std::unique_ptr<FutureArray>(Service::replicate(_f));              \
+  return async_return(                                                         \
+      [fut_ = r_->get()]() { return py::cast(fut_.get().get()->_a()); })
+
+// normalize a key of __getitem__/__setitem__ to a vector of slices
+// a key is an index, a slice or a tuple of them; an index selects a single
+// element (e.g. a slice of length 1)
+static std::vector<py::slice> to_slices(const py::object &key) {
+  std::vector<py::slice> res;
+  auto add = [&res](const py::handle &k) {
+    if (py::isinstance<py::slice>(k)) {
+      res.emplace_back(py::reinterpret_borrow<py::slice>(k));
+    } else {
+      auto i = k.cast<py::ssize_t>();
+      py::object stop = i == -1 ? py::object(py::none()) : py::int_(i + 1);
+      res.emplace_back(py::reinterpret_steal<py::slice>(
+          PySlice_New(py::int_(i).ptr(), stop.ptr(), py::int_(1).ptr())));
+    }
+  };
+  if (py::isinstance<py::tuple>(key)) {
+    for (auto k : key) {
+      add(k);
+    }
+  } else {
+    add(key);
+  }
+  return res;
+}
+
+static py::dict to_dict(const flushes::Counts &c) {
+  py::dict d;
+  d["flushes"] = c._flushes;
+  d["ops"] = c._ops;
+  d["kernel_ops"] = c._kernelOps;
+  return d;
+}
+
+// flush statistics of this process as a dict (see FlushStats.hpp)
+static py::dict flush_stats() {
+  auto res = to_dict(flushes::total());
+  py::dict causes;
+  for (auto &[cause, counts] : flushes::by_cause()) {
+    causes[py::str(cause)] = to_dict(counts);
+  }
+  py::dict sites;
+  for (auto &[site, s] : flushes::by_site()) {
+    auto d = to_dict(s._counts);
+    d["function"] = s._func;
+    d["cause"] = s._cause;
+    sites[py::str(site)] = d;
+  }
+  res["by_cause"] = causes;
+  res["by_site"] = sites;
+  return res;
+}
+
+// runtime statistics of this process as a dict (see Stats.hpp)
+// expects all deferred ops to be completed
+static py::dict runtime_stats() {
+  py::dict res;
+  for (int c = 0; c < stats::COUNTER_LAST; ++c) {
+    auto counter = static_cast<stats::Counter>(c);
+    res[stats::name(counter)] = stats::get(counter);
+  }
+  res["flushes"] = flushes::total()._flushes;
+
+  // arrays known to the registry, views share their base's allocation
+  auto ids = Registry::get_all();
+  std::unordered_map<const void *, uint64_t> allocs;
+  uint64_t nLive = 0;
+  for (auto id : ids) {
+    try {
+      auto fut = Registry::get(id);
+      // not computed yet, e.g. in an open loop body
+      if (fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        continue;
+      }
+      auto ary = std::dynamic_pointer_cast<NDArray>(fut.get());
+      if (!ary || !ary->owned_data()._allocated) {
+        continue;
+      }
+      ++nLive;
+      auto &bytes = allocs[ary->owned_data()._allocated];
+      bytes = std::max(bytes, ary->local_size() * ary->item_size());
+    } catch (const std::exception &) {
+      // the op producing it failed
+    }
+  }
+  uint64_t nBytes = 0;
+  for (auto &a : allocs) {
+    nBytes += a.second;
+  }
+  res["registered_arrays"] = ids.size();
+  res["live_arrays"] = nLive;
+  res["live_bytes"] = nBytes;
+  return res;
+}
+
 // Finally our Python module
 PYBIND11_MODULE(_sharpy, m) {
 
@@ -170,41 +263,110 @@ PYBIND11_MODULE(_sharpy, m) {
   def_enums(m);
   py::enum_<_RANKS>(m, "_Ranks").value("_REPLICATED", REPLICATED);
 
-  m.def("fini", &fini)
-      .def("init", &init)
-      .def("sync", &sync_promises)
+  // the runtime does not touch the GIL, but the worker thread needs it
+  m.def("fini",
+        []() {
+          py::gil_scoped_release release;
+          fini();
+        })
+      .def("init",
+           [](bool cw, const std::string &libidtr) {
+             py::gil_scoped_release release;
+             init(cw, libidtr);
+           })
+      .def("sync",
+           []() {
+             // flush with the GIL held to capture the call site
+             Service::run();
+             py::gil_scoped_release release;
+             sync_promises();
+           })
       .def("myrank", &myrank)
+      .def("_flush_stats", &flush_stats)
+      .def("_reset_flush_stats", &flushes::reset)
+      .def("_stats", &runtime_stats)
+      .def("_reset_stats",
+           []() {
+             stats::reset();
+             flushes::reset();
+           })
       .def("_get_slice", &GetItem::get_slice)
       .def("_get_locals",
-           [](const FutureArray &f, py::handle h) {
-             PY_SYNC_RETURN(GetItem::get_locals(f, h));
+           [](const FutureArray &f) {
+             PY_SYNC_RETURN(GetItem::get_locals(f));
+           })
+      .def("_get_locals_async",
+           [](const FutureArray &f) {
+             PY_ASYNC_RETURN(GetItem::get_locals(f));
            })
       .def("_from_locals", &IO::from_locals)
+      .def("_from_dlpack", &IO::from_dlpack)
+      .def("_save",
+           [](const std::vector<FutureArray *> &a, const std::string &path,
+              bool compress, py::object callback) {
+             Loop::check_sync();
+             auto fut = IO::save(a, path, compress, callback);
+             PY_SYNC_RETURN(fut);
+           })
+      .def("_load", &IO::load)
+      .def("_load_raw", &IO::load_raw)
+      .def("_set_from_numpy",
+           [](FutureArray &f, const std::vector<py::slice> &v,
+              const py::object &b, rank_type root) {
+             SetItem::set_from_numpy(f, v, b, root);
+           })
       .def("_gather",
            [](const FutureArray &f, rank_type root = REPLICATED) {
              PY_SYNC_RETURN(GetItem::gather(f, root));
            })
+      .def("_gather_async",
+           [](const FutureArray &f, rank_type root) {
+             PY_ASYNC_RETURN(GetItem::gather(f, root));
+           })
       .def("to_numpy",
-           [](const FutureArray &f) { PY_SYNC_RETURN(IO::to_numpy(f)); });
+           [](const FutureArray &f, rank_type root) {
+             PY_SYNC_RETURN(IO::to_numpy(f, root));
+           })
+      .def("_to_numpy_async",
+           [](const FutureArray &f, rank_type root) {
+             PY_ASYNC_RETURN(IO::to_numpy(f, root));
+           })
+      .def("_to_numpy_chunks", [](const FutureArray &f, py::object callback,
+                                  uint64_t chunkBytes, rank_type root) {
+        Loop::check_sync();
+        // the callback must be captured while we hold the GIL
+        auto fut = IO::to_numpy_chunks(f, callback, chunkBytes, root);
+        PY_SYNC_RETURN(fut);
+      });
 
   py::class_<Creator>(m, "Creator")
-      .def("full", &Creator::full)
+      .def("full", py::overload_cast<const shape_type &, const py::object &,
+                                     DTypeId, const std::string &, uint64_t>(
+                       &Creator::full))
       .def("arange", &Creator::arange)
       .def("linspace", &Creator::linspace);
 
   py::class_<EWUnyOp>(m, "EWUnyOp").def("op", &EWUnyOp::op);
   py::class_<IEWBinOp>(m, "IEWBinOp").def("op", &IEWBinOp::op);
-  py::class_<EWBinOp>(m, "EWBinOp").def("op", &EWBinOp::op);
+  py::class_<EWBinOp>(m, "EWBinOp")
+      .def("op", py::overload_cast<EWBinOpId, const py::object &,
+                                   const py::object &>(&EWBinOp::op));
   py::class_<ReduceOp>(m, "ReduceOp").def("op", &ReduceOp::op);
   py::class_<ManipOp>(m, "ManipOp").def("reshape", &ManipOp::reshape);
   py::class_<LinAlgOp>(m, "LinAlgOp").def("vecdot", &LinAlgOp::vecdot);
 
-  py::class_<FutureArray>(m, "SHARPYFuture")
+  // the native array type, sharpy/ndarray.py adds Python-only methods
+  py::class_<FutureArray> ndarray(m, "ndarray");
+  ndarray
       // attributes we can get from the future itself
       .def_property_readonly(
           "dtype", [](const FutureArray &f) { return f.get().dtype(); })
       .def_property_readonly(
           "ndim", [](const FutureArray &f) { return f.get().rank(); })
+      .def_property_readonly(
+          "device", [](const FutureArray &f) { return f.get().device(); })
+      // formerly the wrapped future, kept for compatibility
+      .def_property_readonly("_t", [](const py::object &self) { return self; })
       // attributes we can get from future without additional computation
       .def_property_readonly(
           "shape", [](const FutureArray &f) { SYNC_RETURN(f, shape); })
@@ -221,20 +383,88 @@ PYBIND11_MODULE(_sharpy, m) {
            [](const FutureArray &f) { REPL_SYNC_RETURN(f, __int__); })
       .def("__index__",
            [](const FutureArray &f) { REPL_SYNC_RETURN(f, __int__); })
+      // same as above but returning a concurrent.futures.Future
+      .def("bool_async",
+           [](const FutureArray &f) { REPL_ASYNC_RETURN(f, __bool__); })
+      .def("float_async",
+           [](const FutureArray &f) { REPL_ASYNC_RETURN(f, __float__); })
+      .def("int_async",
+           [](const FutureArray &f) { REPL_ASYNC_RETURN(f, __int__); })
       // attributes returning a new FutureArray
-      .def("astype", &ManipOp::astype)
-      .def("to_device", &ManipOp::to_device)
-      .def("__getitem__", &GetItem::__getitem__)
-      .def("__setitem__", &SetItem::__setitem__)
+      .def("astype", &ManipOp::astype, py::arg("dtype"),
+           py::arg("copy") = false)
+      .def("to_device", &ManipOp::to_device, py::arg("device") = "")
+      .def("__getitem__",
+           [](const FutureArray &f, const py::object &key) {
+             return GetItem::__getitem__(f, to_slices(key));
+           })
+      .def("__setitem__",
+           [](FutureArray &f, const py::object &key, const py::object &value) {
+             if (py::isinstance<FutureArray>(value) &&
+                 value.cast<const FutureArray &>().get().dtype() !=
+                     f.get().dtype()) {
+               throw py::value_error(
+                   "Mismatching data type in setitem: " +
+                   py::str(py::cast(value.cast<const FutureArray &>()
+                                        .get()
+                                        .dtype()))
+                       .cast<std::string>() +
+                   ", expecting " +
+                   py::str(py::cast(f.get().dtype())).cast<std::string>());
+             }
+             SetItem::__setitem__(f, to_slices(key), value);
+           })
+      .def("_item",
+           [](const FutureArray &f, const std::vector<int64_t> &idx) {
+             auto fut = GetItem::item(f, idx);
+             PY_SYNC_RETURN(fut);
+           })
+      .def("_itemset", &SetItem::itemset)
+      .def(
+          "__dlpack__",
+          [](const FutureArray &f, const py::object &stream) {
+            PY_SYNC_RETURN(IO::to_dlpack(f));
+          },
+          py::arg("stream") = py::none())
+      .def("__dlpack_device__", &IO::dlpack_device)
       .def("map", &SetItem::map);
+  // operators go straight to the deferred ops
+  for (auto &[name, op] : EWBinOpDunders) {
+    ndarray.def(name, [op = op](const py::object &a, const py::object &b) {
+      return EWBinOp::op(op, a, b);
+    });
+  }
+  for (auto &[name, op] : EWUnyOpDunders) {
+    ndarray.def(name,
+                [op = op](const FutureArray &a) { return EWUnyOp::op(op, a); });
+  }
+#undef REPL_ASYNC_RETURN
+#undef PY_ASYNC_RETURN
 #undef REPL_SYNC_RETURN
 #undef SYNC_RETURN
 
+  py::class_<AsyncSave>(m, "_AsyncSave")
+      .def(py::init<const std::vector<FutureArray *> &, const std::string &,
+                    bool>())
+      .def("done", &AsyncSave::done)
+      .def("wait", &AsyncSave::wait);
+
+  py::class_<Loop>(m, "_Loop")
+      .def(py::init<const std::vector<FutureArray *> &, int64_t>())
+      .def("args", &Loop::args)
+      .def("condition", &Loop::condition)
+      .def("end", &Loop::end)
+      .def("abort", &Loop::abort);
+
+  py::class_<JitRecording>(m, "_JitRecording")
+      .def(py::init<const std::vector<FutureArray *> &>())
+      .def("finish", &JitRecording::finish)
+      .def("replay", &JitRecording::replay)
+      .def("valid", &JitRecording::valid);
+  m.def("_jit_signature", &jit_signature);
+
   py::class_<Random>(m, "Random")
       .def("seed", &Random::seed)
       .def("uniform", &Random::rand);
-
-  // py::class_<dpdlpack>(m, "dpdlpack")
-  //     .def("__dlpack__", &dpdlpack.__dlpack__);
 }
 } // namespace SHARPY
@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  C++ API (see api.hpp), a thin layer over the classes the Python module
+  binds.
+*/
+
+#include "sharpy/api.hpp"
+#include "sharpy/CollComm.hpp"
+#include "sharpy/Creator.hpp"
+#include "sharpy/Deferred.hpp"
+#include "sharpy/EWBinOp.hpp"
+#include "sharpy/EWUnyOp.hpp"
+#include "sharpy/Factory.hpp"
+#include "sharpy/IO.hpp"
+#include "sharpy/ManipOp.hpp"
+#include "sharpy/NDArray.hpp"
+#include "sharpy/ReduceOp.hpp"
+#include "sharpy/Registry.hpp"
+#include "sharpy/Runtime.hpp"
+#include "sharpy/Service.hpp"
+#include "sharpy/Transceiver.hpp"
+#include "sharpy/jit/mlir.hpp"
+
+#include <pybind11/embed.h>
+
+#include <future>
+
+namespace SHARPY {
+namespace api {
+
+// the interpreter we started, if any
+static std::unique_ptr<py::scoped_interpreter> interpreter;
+static PyThreadState *mainThreadState = nullptr;
+
+/// Releases the GIL if the calling thread holds it, e.g. when called from
+/// an application which also runs Python. The worker thread needs it.
+struct NoGIL {
+  PyThreadState *_state;
+  NoGIL()
+      : _state(Py_IsInitialized() && PyGILState_Check() ? PyEval_SaveThread()
+                                                       : nullptr) {}
+  ~NoGIL() {
+    if (_state) {
+      PyEval_RestoreThread(_state);
+    }
+  }
+};
+
+static PyScalar to_pyscalar(double v, DTypeId dtype) {
+  PyScalar s;
+  if (dtype == FLOAT64 || dtype == FLOAT32) {
+    s._float = v;
+  } else {
+    s._int = static_cast<int64_t>(v);
+  }
+  return s;
+}
+
+// wait for array f and return it
+static NDArray::ptr_type wait(const FutureArray &f) {
+  NoGIL nogil;
+  Service::run();
+  auto ary = std::dynamic_pointer_cast<NDArray>(f.get().get());
+  if (!ary) {
+    throw std::invalid_argument("Expected NDArray.");
+  }
+  return ary;
+}
+
+// *************************************************************************
+
+Array::Array(FutureArray *f) : _impl(f) {}
+
+DTypeId Array::dtype() const { return impl().get().dtype(); }
+shape_t Array::shape() const { return impl().get().shape(); }
+int Array::ndim() const { return impl().get().rank(); }
+const std::string &Array::device() const { return impl().get().device(); }
+uint64_t Array::team() const { return impl().get().team(); }
+
+const FutureArray &Array::impl() const {
+  if (!_impl) {
+    throw std::invalid_argument("Invalid (default-constructed) array.");
+  }
+  return *_impl;
+}
+
+// *************************************************************************
+
+void init(const std::string &libidtr, bool cw) {
+  static bool initedAPI = false;
+  if (!Py_IsInitialized()) {
+    // our Python objects need an interpreter but not the GIL
+    interpreter = std::make_unique<py::scoped_interpreter>(false);
+    mainThreadState = PyEval_SaveThread();
+  }
+  if (!initedAPI) {
+    initFactories();
+    jit::init();
+    initedAPI = true;
+  }
+  NoGIL nogil;
+  SHARPY::init(cw, libidtr);
+}
+
+void fini() {
+  {
+    NoGIL nogil;
+    SHARPY::fini();
+  }
+  if (interpreter) {
+    PyEval_RestoreThread(mainThreadState);
+    interpreter.reset();
+  }
+}
+
+void sync() {
+  NoGIL nogil;
+  sync_promises();
+}
+
+uint64_t rank() { return myrank(); }
+uint64_t nranks() { return getTransceiver()->nranks(); }
+
+// *************************************************************************
+
+Array full(const shape_t &shape, double val, DTypeId dtype,
+           const std::string &device, uint64_t team) {
+  return Array(
+      Creator::full(shape, to_pyscalar(val, dtype), dtype, device, team));
+}
+
+Array arange(uint64_t start, uint64_t end, uint64_t step, DTypeId dtype,
+             const std::string &device, uint64_t team) {
+  return Array(Creator::arange(start, end, step, dtype, device, team));
+}
+
+Array linspace(double start, double end, uint64_t num, bool endpoint,
+               DTypeId dtype, const std::string &device, uint64_t team) {
+  return Array(
+      Creator::linspace(start, end, num, endpoint, dtype, device, team));
+}
+
+// *************************************************************************
+
+Array ewbin(EWBinOpId op, const Array &a, const Array &b) {
+  return Array(EWBinOp::op(op, a.impl(), b.impl()));
+}
+
+Array ewbin(EWBinOpId op, const Array &a, double b) {
+  return ewbin(op, a, full({}, b, a.dtype(), a.device(), a.team()));
+}
+
+Array ewbin(EWBinOpId op, double a, const Array &b) {
+  return ewbin(op, full({}, a, b.dtype(), b.device(), b.team()), b);
+}
+
+Array ewuny(EWUnyOpId op, const Array &a) {
+  return Array(EWUnyOp::op(op, a.impl()));
+}
+
+Array reduce(ReduceOpId op, const Array &a, const shape_t &dims) {
+  dim_vec_type dv(dims.begin(), dims.end());
+  if (dv.empty()) {
+    for (int i = 0; i < a.ndim(); ++i) {
+      dv.emplace_back(i);
+    }
+  }
+  return Array(ReduceOp::op(op, a.impl(), dv));
+}
+
+Array sum(const Array &a) { return reduce(SUM, a); }
+
+Array reshape(const Array &a, const shape_t &shape) {
+  py::gil_scoped_acquire gil;
+  return Array(ManipOp::reshape(a.impl(), shape, py::none()));
+}
+
+Array astype(const Array &a, DTypeId dtype) {
+  py::gil_scoped_acquire gil;
+  return Array(ManipOp::astype(a.impl(), dtype, py::bool_(false)));
+}
+
+// *************************************************************************
+
+double to_scalar(const Array &a) {
+  auto r = std::unique_ptr<FutureArray>(Service::replicate(a.impl()));
+  return wait(*r)->__float__();
+}
+
+void gather(const Array &a, void *out, uint64_t root) {
+  if (getTransceiver()->is_cw()) {
+    throw std::runtime_error("gather is not supported in c/w mode.");
+  }
+  // communication happens in the worker thread
+  auto done = std::make_shared<std::promise<void>>();
+  auto fut = done->get_future();
+  defer_lambda([](auto &&, auto &&, auto &&) { return true; },
+               [done, guid = a.impl().get().guid(), root, out]() {
+                 try {
+                   auto ary = std::dynamic_pointer_cast<NDArray>(
+                       Registry::get(guid).get());
+                   if (!ary) {
+                     throw std::invalid_argument("Expected NDArray in gather.");
+                   }
+                   gather_array(ary, root, out);
+                   done->set_value();
+                 } catch (...) {
+                   done->set_exception(std::current_exception());
+                 }
+               });
+  NoGIL nogil;
+  Service::run();
+  fut.get();
+}
+
+LocalPart local(const Array &a) {
+  auto ary = wait(a.impl());
+  auto nd = ary->ndims();
+  LocalPart res{ary->data(),
+                {ary->local_shape(), ary->local_shape() + nd},
+                {ary->local_strides(), ary->local_strides() + nd},
+                ary->local_offsets()};
+  if (res.offsets.empty()) {
+    res.offsets.resize(nd, 0);
+  }
+  return res;
+}
+
+Array from_local(std::shared_ptr<void> data, const shape_t &localShape,
+                 DTypeId dtype) {
+  auto ptr = data.get();
+  return Array(IO::from_local(
+      dtype, localShape, ptr,
+      std::make_unique<SharedBaseObject<std::shared_ptr<void>>>(
+          std::move(data))));
+}
+
+} // namespace api
+} // namespace SHARPY
@@ -4,9 +4,12 @@
     Intel Distributed Runtime for MLIR
 */
 
+#include <sharpy/CommStats.hpp>
 #include <sharpy/MPITransceiver.hpp>
 #include <sharpy/MemRefType.hpp>
 #include <sharpy/NDArray.hpp>
+#include <sharpy/Stats.hpp>
+#include <sharpy/Trace.hpp>
 #include <sharpy/UtilsAndTypes.hpp>
 
 #include <imex/Dialect/NDArray/IR/NDArrayDefs.h>
@@ -60,8 +63,16 @@ template <typename T> WaitHandle<T> *mkWaitHandle(T &&fini) {
 };
 
 extern "C" {
+/// called by jit-compiled code to count the work of a kernel
+/// (see jit/Roofline.hpp)
+void _idtr_count_work(int64_t flops, int64_t bytes) {
+  SHARPY::stats::add(SHARPY::stats::EST_FLOPS, flops);
+  SHARPY::stats::add(SHARPY::stats::EST_BYTES, bytes);
+}
+
 void _idtr_wait(WaitHandleBase *handle) {
   if (handle) {
+    TRACE_SCOPE("wait", "comm");
     handle->wait();
     delete handle;
   }
@@ -339,6 +350,8 @@ using MRIdx1d = SHARPY::Unranked1DMemRefType<int64_t>;
 // FIXME hard-coded for contiguous layout
 template <typename T>
 void _idtr_reduce_all(int64_t dataRank, void *dataDescr, int op) {
+  TRACE_SCOPE("reduce_all", "comm");
+  COMM_SITE("reduce_all");
   auto tc = SHARPY::getTransceiver();
   if (!tc)
     return;
@@ -348,6 +361,8 @@ void _idtr_reduce_all(int64_t dataRank, void *dataDescr, int op) {
   auto t = SHARPY::DTYPE<T>::value;
   auto r = dataRank ? data.sizes()[0] : 1;
   auto o = mlir2sharpy(static_cast<imex::ndarray::ReduceOpId>(op));
+  SHARPY::stats::add(SHARPY::stats::REDUCTIONS);
+  SHARPY::stats::add(SHARPY::stats::REDUCTION_BYTES, r * sizeof(T));
   tc->reduce_all(d, t, r, o);
 }
 
@@ -381,6 +396,8 @@ WaitHandleBase *_idtr_copy_reshape(SHARPY::DTypeId sharpytype,
                                    int64_t *oGShapePtr, int64_t *oOffsPtr,
                                    void *oDataPtr, int64_t *oDataShapePtr,
                                    int64_t *oDataStridesPtr) {
+  TRACE_SCOPE("reshape", "comm");
+  COMM_SITE("reshape");
 #ifdef NO_TRANSCEIVER
   initMPIRuntime();
   tc = SHARPY::getTransceiver();
@@ -490,6 +507,8 @@ WaitHandleBase *_idtr_copy_reshape(SHARPY::DTypeId sharpytype,
   }
 
   SHARPY::Buffer sendbuff(totSSz * sizeof_dtype(sharpytype), 2);
+  SHARPY::stats::add(SHARPY::stats::RESHAPES);
+  SHARPY::stats::add(SHARPY::stats::RESHAPE_BYTES, sendbuff.size());
   bufferizeN(iNDims, iDataPtr, iDataShapePtr, iDataStridesPtr, sharpytype, N,
              lsOffs.data(), lsEnds.data(), sendbuff.data());
   auto hdl = tc->alltoall(sendbuff.data(), sszs.data(), soffs.data(),
@@ -809,6 +828,8 @@ void *_idtr_update_halo(SHARPY::DTypeId sharpytype, int64_t ndims,
                         int64_t *rightHaloShape, int64_t *rightHaloStride,
                         void *rightHaloData, SHARPY::Transceiver *tc,
                         int64_t key) {
+  TRACE_SCOPE("halo", "comm");
+  COMM_SITE("halo");
 
 #ifdef NO_TRANSCEIVER
   initMPIRuntime();
@@ -880,6 +901,14 @@ void *_idtr_update_halo(SHARPY::DTypeId sharpytype, int64_t ndims,
   void *rSendData =
       cache->_bufferizeSend ? cache->_sendRBuff.data() : ownedData;
 
+  SHARPY::stats::add(SHARPY::stats::HALO_UPDATES);
+  SHARPY::stats::add(
+      SHARPY::stats::HALO_BYTES,
+      nbytes * (std::accumulate(cache->_lSendSize.begin(),
+                                cache->_lSendSize.end(), int64_t(0)) +
+                std::accumulate(cache->_rSendSize.begin(),
+                                cache->_rSendSize.end(), int64_t(0))));
+
   // communicate left/right halos
   if (cache->_bufferizeSend) {
     bufferize(ownedData, sharpytype, ownedShape, ownedStride,
@@ -12,8 +12,29 @@
 
 namespace SHARPY {
 
+// copy local data of a_ptr into contiguous buffer outPtr
+void bufferize(NDArray::ptr_type a_ptr, void *outPtr);
+// copy local rows [start, end) of a_ptr into contiguous buffer outPtr
+void bufferize_rows(NDArray::ptr_type a_ptr, int64_t start, int64_t end,
+                    void *outPtr);
+// copy contiguous buffer inPtr into local rows [start, end) of a_ptr
+// (a single element if a_ptr is 0d)
+void unbufferize_rows(NDArray::ptr_type a_ptr, int64_t start, int64_t end,
+                      const void *inPtr);
+
 void gather_array(NDArray::ptr_type a_ptr, rank_type root, void *outPtr);
 
+// @return offsets and sizes in first dimension of all partitions of a_ptr:
+// [off_0, sz_0, off_1, sz_1, ...]. A single pair if a_ptr is not distributed.
+std::vector<int64_t> gather_partitions(NDArray::ptr_type a_ptr);
+
+// Gather global rows [start, end) of a_ptr into contiguous buffer outPtr.
+// @param parts partitions as returned by gather_partitions
+// @param outPtr touched only if on root and/or root==REPLICATED or if not
+// distributed
+void gather_rows(NDArray::ptr_type a_ptr, const std::vector<int64_t> &parts,
+                 int64_t start, int64_t end, rank_type root, void *outPtr);
+
 struct CollComm {
   using map_info_type = std::vector<std::vector<int>>;
 
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Opt-in communication profiling.
+
+  Enabled by setting SHARPY_COMM_STATS to an output prefix ("1" means
+  "sharpy_comm"). MPITransceiver then records for every collective type
+  and call site the number of calls, the bytes sent, the time spent in the
+  call and the time spent waiting for non-blocking calls to complete. It
+  also counts the bytes sent to every other rank. At fini every rank
+  writes <prefix>.<rank>.json; scripts/comm_matrix.py merges them into a
+  rank-to-rank matrix.
+
+  Call sites are named by COMM_SITE in the functions which communicate
+  (e.g. "halo", "reshape"), unnamed communication counts as "other".
+  Site names must be string literals.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace SHARPY {
+namespace comm {
+
+extern bool _enabled;
+extern thread_local const char *_site;
+
+/// @return true if communication profiling is enabled (SHARPY_COMM_STATS)
+inline bool enabled() { return _enabled; }
+
+enum Collective : int {
+  BARRIER,
+  BCAST,
+  ALLREDUCE,
+  ALLTOALLV,
+  ALLTOALL,
+  ALLGATHERV,
+  GATHERV,
+  SCATTERV,
+  SENDRECV,
+  COLLECTIVE_LAST
+};
+
+/// called collective c with bytes in total, sent toRank[i] bytes to rank i
+/// (if not null), which took ns
+void record(Collective c, uint64_t bytes, const uint64_t *toRank,
+            uint64_t ns);
+/// a non-blocking call of c returned handle
+void issued(Collective c, uint64_t handle);
+/// waited ns for handle to complete
+void waited(uint64_t handle, uint64_t ns);
+
+/// write the records of this process, called by fini
+void write();
+
+/// names the call site of communication in its lifetime
+class Site {
+  const char *_prev;
+
+public:
+  Site(const char *name) : _prev(_site) { _site = name; }
+  ~Site() { _site = _prev; }
+  Site(const Site &) = delete;
+  Site &operator=(const Site &) = delete;
+};
+
+} // namespace comm
+} // namespace SHARPY
+
+#define COMM_CONCAT_(_a, _b) _a##_b
+#define COMM_CONCAT(_a, _b) COMM_CONCAT_(_a, _b)
+/// communication in the rest of the enclosing block has call site _name
+#define COMM_SITE(_name)                                                       \
+  ::SHARPY::comm::Site COMM_CONCAT(commSite_, __LINE__)(_name)
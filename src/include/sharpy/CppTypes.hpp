@@ -343,6 +343,13 @@ enum FactoryId : int {
   F_SETITEM,
   F_ASTYPE,
   F_TODEVICE,
+  F_GATHERCHUNKS,
+  F_SETITEMNUMPY,
+  F_ITEM,
+  F_ITEMSET,
+  F_SAVE,
+  F_LOAD,
+  F_TODLPACK,
   FACTORY_LAST
 };
 
@@ -17,6 +17,9 @@ struct Creator {
   static FutureArray *full(const shape_type &shape, const py::object &val,
                            DTypeId dtype, const std::string &device,
                            uint64_t team);
+  static FutureArray *full(const shape_type &shape, PyScalar val,
+                           DTypeId dtype, const std::string &device,
+                           uint64_t team);
   static FutureArray *arange(uint64_t start, uint64_t end, uint64_t step,
                              DTypeId dtype, const std::string &device,
                              uint64_t team);
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Data structures of the DLPack exchange protocol (ABI version 0.x, as
+  exchanged through "dltensor" capsules by __dlpack__).
+  See https://dmlc.github.io/dlpack/latest/c_api.html
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace SHARPY {
+namespace dlpack {
+
+enum DLDeviceType : int32_t {
+  kDLCPU = 1,
+  kDLCUDA = 2,
+  kDLCUDAHost = 3,
+  kDLOpenCL = 4,
+  kDLVulkan = 7,
+  kDLMetal = 8,
+  kDLVPI = 9,
+  kDLROCM = 10,
+  kDLROCMHost = 11,
+  kDLExtDev = 12,
+  kDLCUDAManaged = 13,
+  kDLOneAPI = 14,
+};
+
+struct DLDevice {
+  DLDeviceType device_type;
+  int32_t device_id;
+};
+
+enum DLDataTypeCode : uint8_t {
+  kDLInt = 0,
+  kDLUInt = 1,
+  kDLFloat = 2,
+  kDLBfloat = 4,
+  kDLComplex = 5,
+  kDLBool = 6,
+};
+
+struct DLDataType {
+  uint8_t code;
+  uint8_t bits;
+  uint16_t lanes;
+};
+
+struct DLTensor {
+  void *data;
+  DLDevice device;
+  int32_t ndim;
+  DLDataType dtype;
+  int64_t *shape;
+  int64_t *strides; // in elements, nullptr means compact row-major
+  uint64_t byte_offset;
+};
+
+struct DLManagedTensor {
+  DLTensor dl_tensor;
+  void *manager_ctx;
+  void (*deleter)(DLManagedTensor *self);
+};
+
+/// name of capsules carrying a DLManagedTensor
+constexpr const char *CAPSULE_NAME = "dltensor";
+/// name of capsules after the DLManagedTensor was consumed
+constexpr const char *USED_CAPSULE_NAME = "used_dltensor";
+
+} // namespace dlpack
+} // namespace SHARPY
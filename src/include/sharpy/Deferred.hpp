@@ -28,6 +28,17 @@ class DepManager;
 
 extern void process_promises(const std::string &libidtr);
 
+/// Python source location an operation was deferred from
+struct SrcLoc {
+  std::string _file;
+  std::string _func;
+  int _line;
+};
+
+/// @return true if operations get annotated with their Python source
+/// location (SHARPY_LOCATIONS)
+extern bool use_src_locs();
+
 // interface for promises/tasks to generate MLIR or execute immediately.
 struct Runable {
   using ptr_type = std::unique_ptr<Runable>;
@@ -48,8 +59,13 @@ struct Runable {
   };
   virtual bool isDeleter() { return false; }
   virtual FactoryId factory() const = 0;
+  /// @return why the queue gets flushed if generate_mlir requests run()
+  virtual const char *flush_cause() const;
   virtual void defer(ptr_type &&);
   static void fini();
+
+  /// where the operation was deferred from, set by push_runable if enabled
+  std::unique_ptr<SrcLoc> _srcLoc;
 };
 
 extern void push_runable(Runable::ptr_type &&r);
@@ -145,8 +161,10 @@ struct DeferredLambda : public Runable {
 
   G _g;
   R _r;
+  const char *_cause;
 
-  DeferredLambda(G g, R r) : _g(g), _r(r) {}
+  DeferredLambda(G g, R r, const char *cause)
+      : _g(g), _r(r), _cause(cause) {}
 
   bool isDeleter() override { return D; }
 
@@ -160,12 +178,19 @@ struct DeferredLambda : public Runable {
   FactoryId factory() const override {
     throw(std::runtime_error("No Factory for DeferredLambda."));
   }
+
+  const char *flush_cause() const override { return _cause; }
 };
 
-template <typename G, typename R> void defer_lambda(G &&g, R &&r) {
-  push_runable(std::move(std::make_unique<DeferredLambda<G, R, false>>(g, r)));
+/// cause is reported as flush cause if g requests running r
+/// (a string literal)
+template <typename G, typename R>
+void defer_lambda(G &&g, R &&r, const char *cause = "callback") {
+  push_runable(std::move(
+      std::make_unique<DeferredLambda<G, R, false>>(g, r, cause)));
 }
 template <typename G, typename R> void defer_del_lambda(G &&g, R &&r) {
-  push_runable(std::move(std::make_unique<DeferredLambda<G, R, true>>(g, r)));
+  push_runable(std::move(
+      std::make_unique<DeferredLambda<G, R, true>>(g, r, "drop")));
 }
 } // namespace SHARPY
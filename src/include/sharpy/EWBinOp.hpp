@@ -14,5 +14,7 @@ namespace SHARPY {
 struct EWBinOp {
   static FutureArray *op(EWBinOpId op, const py::object &a,
                          const py::object &b);
+  static FutureArray *op(EWBinOpId op, const FutureArray &a,
+                         const FutureArray &b);
 };
 } // namespace SHARPY
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Statistics about flushes, e.g. about why the worker stopped adding ops to
+  the current function and had to compile and run it. Fewer flushes mean
+  larger fused kernels.
+
+  Each flush is attributed to a cause (see Runable::flush_cause) and, if
+  Python call sites get captured (SHARPY_LOCATIONS or SHARPY_FLUSH_WARN), to
+  the Python line which requested it. With SHARPY_FLUSH_WARN=<n> a warning
+  gets printed once a call site caused n flushes, typically a value read in
+  a loop.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace SHARPY {
+
+struct SrcLoc;
+
+namespace flushes {
+
+struct Counts {
+  uint64_t _flushes = 0;
+  uint64_t _ops = 0;       // deferred ops fused into flushed functions
+  uint64_t _kernelOps = 0; // MLIR ops in flushed functions
+};
+
+struct Site {
+  std::string _func;
+  std::string _cause; // of the last flush
+  Counts _counts;
+};
+
+/// @return true if flushes should be attributed to Python call sites
+bool capture_sites();
+
+/// record a flush of nOps deferred ops and kernelOps MLIR ops
+/// loc is the call site, if known
+void record(const char *cause, const SrcLoc *loc, uint64_t nOps,
+            uint64_t kernelOps);
+
+/// @return totals over all flushes
+Counts total();
+/// @return counts per cause
+std::map<std::string, Counts> by_cause();
+/// @return counts per call site ("file:line")
+std::map<std::string, Site> by_site();
+/// forget all recorded flushes
+void reset();
+
+} // namespace flushes
+} // namespace SHARPY
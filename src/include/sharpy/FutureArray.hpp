@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "Loop.hpp"
 #include "Service.hpp"
 #include "array_i.hpp"
 
@@ -17,28 +18,51 @@ extern bool finied;
 
 class FutureArray {
   array_i::future_type _ftx;
+  // layout the array will have once ready and its fingerprint across
+  // processes, if known (see JitFunc.hpp)
+  std::shared_ptr<const std::vector<int64_t>> _layout;
 
 public:
   FutureArray(array_i::future_type &&f)
-      : _ftx(std::forward<array_i::future_type>(f)) {}
+      : _ftx(std::forward<array_i::future_type>(f)) {
+    Loop::created(_ftx.guid());
+  }
   FutureArray(std::shared_future<array_i::ptr_type> &&f, id_type id, DTypeId dt,
               const shape_type &shape, const std::string &device, uint64_t team)
       : _ftx(std::forward<std::shared_future<array_i::ptr_type>>(f), id, dt,
-             shape, device, team) {}
+             shape, device, team) {
+    Loop::created(_ftx.guid());
+  }
   FutureArray(std::shared_future<array_i::ptr_type> &&f, id_type id, DTypeId dt,
               shape_type &&shape, std::string &&device, uint64_t team)
       : _ftx(std::forward<std::shared_future<array_i::ptr_type>>(f), id, dt,
              std::forward<shape_type>(shape), std::forward<std::string>(device),
-             team) {}
+             team) {
+    Loop::created(_ftx.guid());
+  }
 
   ~FutureArray() {
+    Loop::released(_ftx.guid());
     if (!finied)
-      Service::drop(get().guid());
+      Service::drop(_ftx.guid());
   }
 
-  const array_i::future_type &get() const { return _ftx; }
+  /// throws if the array was computed in a loop body and the loop ended
+  const array_i::future_type &get() const {
+    Loop::check_scoped(_ftx.guid());
+    return _ftx;
+  }
   void put(array_i::future_type &&f) {
     _ftx = std::forward<array_i::future_type>(f);
+    _layout.reset();
+    Loop::created(_ftx.guid());
+  }
+
+  const std::shared_ptr<const std::vector<int64_t>> &layout_hint() const {
+    return _layout;
+  }
+  void set_layout_hint(const std::shared_ptr<const std::vector<int64_t>> &l) {
+    _layout = l;
   }
 };
 } // namespace SHARPY
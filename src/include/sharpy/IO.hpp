@@ -9,11 +9,56 @@
 #include "sharpy/SetGetItem.hpp"
 #include <pybind11/numpy.h>
 namespace py = pybind11;
+#include <memory>
 #include <vector>
 
 namespace SHARPY {
 struct IO {
-  static GetItem::py_future_type to_numpy(const FutureArray &a);
-  static FutureArray *from_locals(const std::vector<py::array> &a);
+  static GetItem::py_future_type to_numpy(const FutureArray &a,
+                                          rank_type root = REPLICATED);
+  static GetItem::py_future_type to_numpy_chunks(const FutureArray &a,
+                                                 py::object &callback,
+                                                 uint64_t chunkBytes,
+                                                 rank_type root);
+  /// @brief wrap local arrays (no copy), one distributed array per element.
+  /// Local blocks are stacked along the first axis in rank order and may
+  /// have different sizes.
+  static std::vector<FutureArray *>
+  from_locals(const std::vector<py::array> &a);
+  /// @brief wrap a contiguous local buffer (no copy), see from_locals.
+  /// owner keeps data alive as long as the array needs it.
+  static FutureArray *from_local(DTypeId dtype, const shape_type &shape,
+                                 void *data, std::unique_ptr<BaseObj> &&owner);
+  static GetItem::py_future_type to_dlpack(const FutureArray &a);
+  static py::tuple dlpack_device(const FutureArray &a);
+  static FutureArray *from_dlpack(const py::capsule &capsule);
+  static GetItem::py_future_type save(const std::vector<FutureArray *> &a,
+                                      const std::string &path, bool compress,
+                                      py::object &callback);
+  static void load(FutureArray &a, const std::string &path,
+                   const std::vector<std::vector<int64_t>> &parts,
+                   int64_t blockRows, bool compressed);
+  static void load_raw(FutureArray &a, const std::string &path,
+                       int64_t offset);
+};
+
+/// @brief An asynchronous checkpoint.
+/// Local partitions are copied at the current point of the deferred stream,
+/// compression and writing happen in the background.
+class AsyncSave {
+public:
+  struct State;
+
+  AsyncSave(const std::vector<FutureArray *> &a, const std::string &path,
+            bool compress);
+  /// @return true if this process finished writing (local, non-blocking)
+  bool done() const;
+  /// wait until all processes are done and call callback(nranks, meta) on
+  /// process 0, see IO::save. Collective.
+  void wait(py::object &callback);
+
+private:
+  std::shared_ptr<State> _state;
+  bool _finished = false;
 };
 } // namespace SHARPY
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Capturing the jitted function generated by a Python function and replaying
+  it on new arguments without running the Python code (see sharpy.jit).
+
+  While a recording is active, the DepManager keeps the compiled function
+  together with the guids/layouts of its inputs and results. A recording can
+  be replayed if the function body compiled into exactly one jitted function
+  which reads only its array arguments and produces only its returned arrays
+  (or updates its arguments in-place).
+
+  The replayed function communicates, so all processes must decide alike
+  whether to replay or to record again. Layout hints and signatures
+  therefore carry a fingerprint of the layouts of all processes, and
+  recordings which fail on one process are invalid on all.
+*/
+
+#pragma once
+
+#include "FutureArray.hpp"
+
+#include <pybind11/pybind11.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace SHARPY {
+
+class JitRecording {
+public:
+  struct State;
+
+  /// start recording, args are the array arguments of the function
+  JitRecording(const std::vector<FutureArray *> &args);
+  /// stop recording, outputs are the (new) arrays returned by the function
+  /// @return empty string if the recording can be replayed, reason otherwise
+  std::string finish(const std::vector<FutureArray *> &outputs);
+  /// run the recorded function on new arguments (without the Python code)
+  /// @return new arrays in the order given to finish()
+  std::vector<FutureArray *> replay(const std::vector<FutureArray *> &args);
+  /// @return false if a replay found arguments with a different layout
+  bool valid() const;
+
+private:
+  std::shared_ptr<State> _state;
+};
+
+/// @return key identifying dtypes, shapes, partitioning and aliasing of
+/// given arrays. Waits for arrays without a layout hint (collective).
+py::bytes jit_signature(const std::vector<FutureArray *> &args);
+
+} // namespace SHARPY
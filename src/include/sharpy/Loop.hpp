@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Loops over arrays which get compiled into a single scf loop
+  (see sharpy.fori_loop and sharpy.while_loop).
+*/
+
+#pragma once
+
+#include "CppTypes.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace SHARPY {
+
+class FutureArray;
+
+/// A loop gets captured by deferring markers around its (Python) body:
+///   Loop(state, n), args(), [condition(cond),] end(state)
+/// All ops deferred in between go into the loop body; the body must not
+/// synchronize.
+/// Misuse is detected on the calling thread, before anything is deferred:
+/// errors on the worker thread cannot be reported to Python.
+class Loop {
+public:
+  struct State;
+
+  /// begin a loop carrying given state,
+  /// a for-loop with n iterations if n >= 0, a while-loop otherwise
+  Loop(const std::vector<FutureArray *> &state, int64_t n);
+  /// @return the arrays representing the carried state within the loop,
+  /// for-loops prepend the iteration index (0d int64 array)
+  std::vector<FutureArray *> args();
+  /// while-loops only: iterate while the 0d array cond is true
+  /// @return the arrays representing the carried state in the loop body
+  std::vector<FutureArray *> condition(const FutureArray &cond);
+  /// end the loop body, state is the carried state for the next iteration
+  /// @return the final state
+  std::vector<FutureArray *> end(const std::vector<FutureArray *> &state);
+  /// discard the loop (e.g. after an exception in its body)
+  void abort();
+
+  /// throw if a loop body is being captured (it must not synchronize)
+  static void check_sync();
+  /// a FutureArray now refers to array guid
+  static void created(id_type guid);
+  /// throw if array guid was computed in the body of a loop which ended
+  static void check_scoped(id_type guid);
+  /// the FutureArray referring to array guid was deleted
+  static void released(id_type guid);
+
+private:
+  void close_body();
+
+  std::shared_ptr<State> _state;
+};
+
+} // namespace SHARPY
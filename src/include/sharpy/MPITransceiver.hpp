@@ -38,6 +38,9 @@ public:
                         DTypeId datatype, void *buffer_recv);
   virtual void gather(void *buffer, const int *counts, const int *displacements,
                       DTypeId datatype, rank_type root);
+  virtual void scatter(void *buffer, const int *counts,
+                       const int *displacements, DTypeId datatype,
+                       rank_type root);
   virtual void send_recv(void *buffer_send, int count_send,
                          DTypeId datatype_send, int dest, int source);
   virtual void wait(WaitHandle);
@@ -78,6 +78,8 @@ public:
   // set the base array
   void set_base(const array_i::ptr_type &base);
   void set_base(BaseObj *obj);
+  /// @return the object owning our data, nullptr if we own it
+  const BaseObj *base() const { return _base; }
 
   virtual ~NDArray();
 
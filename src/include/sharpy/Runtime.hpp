@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Starting and stopping the runtime (transceiver, mediator and the worker
+  thread processing deferred ops). Shared by the Python module and the C++
+  API (see api.hpp). None of these functions touch the GIL: callers holding
+  it must release it.
+*/
+
+#pragma once
+
+#include "CppTypes.hpp"
+
+#include <string>
+
+namespace SHARPY {
+
+/// @return rank of calling process
+rank_type myrank();
+/// start the runtime; in c/w mode worker processes do not return
+void init(bool cw, const std::string &libidtr);
+/// stop the runtime, all arrays get dropped
+void fini();
+/// wait until all deferred ops are computed
+void sync_promises();
+
+} // namespace SHARPY
@@ -22,7 +22,8 @@ struct Service {
   static FutureArray *replicate(const FutureArray &a);
   /// start running/executing operations, e.g. trigger compile&run
   /// this is not blocking, use futures for synchronization
-  static service_future_type run();
+  /// cause (a string literal) gets reported in the flush statistics
+  static service_future_type run(const char *cause = "sync");
   /// signal that the given FutureArray is no longer needed and can be deleted
   static void drop(id_type a);
 };
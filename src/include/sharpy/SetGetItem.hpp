@@ -21,14 +21,24 @@ struct GetItem {
                                   const std::vector<py::slice> &v);
   static py::object get_slice(const FutureArray &a,
                               const std::vector<py::slice> &v);
-  static py_future_type get_locals(const FutureArray &a, py::handle h);
+  static py_future_type get_locals(const FutureArray &a);
   static py_future_type gather(const FutureArray &a, rank_type root);
+  static py_future_type item(const FutureArray &a,
+                             const std::vector<int64_t> &idx);
+  static py_future_type gather_chunks(const FutureArray &a,
+                                      py::object &callback,
+                                      uint64_t chunkBytes, rank_type root);
 };
 
 struct SetItem {
   static FutureArray *__setitem__(FutureArray &a,
                                   const std::vector<py::slice> &v,
                                   const py::object &b);
+  static FutureArray *set_from_numpy(FutureArray &a,
+                                     const std::vector<py::slice> &v,
+                                     const py::object &b, rank_type root);
+  static FutureArray *itemset(FutureArray &a, const std::vector<int64_t> &idx,
+                              const py::object &b);
   static FutureArray *map(FutureArray &a, py::object &b);
 };
 } // namespace SHARPY
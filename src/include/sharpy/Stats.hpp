@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Runtime statistics: counters of deferred ops, compiles, kernel executions
+  and communication, exposed as sharpy.stats().
+
+  Counters are atomic and cheap enough to be always on. They live in idtr
+  so that communication functions called from jit-compiled code can count
+  as well.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace SHARPY {
+namespace stats {
+
+/// *_NS counters are in nanoseconds, *_BYTES count bytes sent
+enum Counter : int {
+  DEFERRED_OPS,
+  COMPILES, // actual compiles, e.g. engine-cache misses
+  COMPILE_NS,
+  CACHE_HITS,
+  CACHE_MISSES,
+  KERNELS, // executions of jit-compiled functions
+  KERNEL_NS,
+  HALO_UPDATES,
+  HALO_BYTES,
+  RESHAPES,
+  RESHAPE_BYTES,
+  REDUCTIONS,
+  REDUCTION_BYTES,
+  EST_FLOPS, // counted by jit-compiled code with SHARPY_ROOFLINE
+  EST_BYTES,
+  // gauges, not reset
+  CACHED_ENGINES,
+  COUNTER_LAST
+};
+
+extern std::atomic<uint64_t> _counters[COUNTER_LAST];
+
+/// add v to counter c
+inline void add(Counter c, uint64_t v = 1) {
+  _counters[c].fetch_add(v, std::memory_order_relaxed);
+}
+/// set gauge c to v
+inline void set(Counter c, uint64_t v) {
+  _counters[c].store(v, std::memory_order_relaxed);
+}
+/// @return value of counter c
+inline uint64_t get(Counter c) {
+  return _counters[c].load(std::memory_order_relaxed);
+}
+/// @return the name of counter c as reported to users
+const char *name(Counter c);
+/// reset all counters but gauges
+void reset();
+
+} // namespace stats
+} // namespace SHARPY
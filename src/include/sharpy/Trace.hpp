@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Built-in timeline tracing, independent of ITAC (see itac.hpp).
+
+  Enabled by setting SHARPY_TRACE to an output prefix ("1" means
+  "sharpy_trace"); at fini every rank writes <prefix>.<rank>.json in
+  Chrome/Perfetto trace format. scripts/merge_traces.py merges them into a
+  single timeline.
+
+  Events get recorded into fixed-size per-thread ring buffers
+  (SHARPY_TRACE_EVENTS events per thread), so recording never allocates or
+  locks. Names and categories must be string literals.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace SHARPY {
+namespace trace {
+
+extern bool _enabled;
+
+/// @return true if tracing is enabled (SHARPY_TRACE)
+inline bool enabled() { return _enabled; }
+
+/// @return current time in nanoseconds (steady clock)
+uint64_t now();
+
+/// record an event which started at begin and ends now
+void complete(const char *name, const char *cat, uint64_t begin);
+/// record an event without duration
+void instant(const char *name, const char *cat);
+/// name the calling thread in the trace
+void set_thread_name(const char *name);
+
+/// write the trace of this process, called by fini
+void write();
+
+/// records an event covering its lifetime
+class Scope {
+  const char *_name;
+  const char *_cat;
+  uint64_t _begin;
+
+public:
+  Scope(const char *name, const char *cat)
+      : _name(name), _cat(cat), _begin(_enabled ? now() : 0) {}
+  ~Scope() {
+    if (_begin) {
+      complete(_name, _cat, _begin);
+    }
+  }
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+};
+
+} // namespace trace
+} // namespace SHARPY
+
+#define TRACE_CONCAT_(_a, _b) _a##_b
+#define TRACE_CONCAT(_a, _b) TRACE_CONCAT_(_a, _b)
+/// trace the rest of the enclosing block
+#define TRACE_SCOPE(_name, _cat)                                               \
+  ::SHARPY::trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(_name, _cat)
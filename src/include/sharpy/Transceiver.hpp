@@ -53,6 +53,16 @@ public:
   virtual void gather(void *buffer, const int *counts, const int *displacements,
                       DTypeId datatype, rank_type root) = 0;
 
+  // Scatter data from root, inplace on root.
+  // @param[inout] buffer on root: data to be sent to all processes,
+  //                      part for process i starts at displacements[i];
+  //                      all other processes: buffer to store received data
+  // @param[in]    counts number of elements to be sent to each process
+  //                      (only own count needed on non-root processes)
+  virtual void scatter(void *buffer, const int *counts,
+                       const int *displacements, DTypeId datatype,
+                       rank_type root) = 0;
+
   virtual void send_recv(void *buffer_send, int count_send,
                          DTypeId datatype_send, int dest, int source) = 0;
   virtual void wait(WaitHandle) = 0;
@@ -66,6 +66,20 @@ inline std::string get_text_env(const std::string &name,
   return std::string(default_value);
 }
 
+/// @return output file prefix given by environment variable name:
+/// "1"/"on" mean default_prefix, unset or "0"/"off" mean disabled ("")
+inline std::string get_prefix_env(const std::string &name,
+                                  const std::string &default_prefix) {
+  auto prefix = get_text_env(name);
+  if (prefix == "0" || prefix == "off" || prefix == "OFF") {
+    return {};
+  }
+  if (prefix == "1" || prefix == "on" || prefix == "ON") {
+    return default_prefix;
+  }
+  return prefix;
+}
+
 inline bool useGPU() {
   auto device = get_text_env("SHARPY_DEVICE");
   return !(device.empty() || device == "host" || device == "cpu");
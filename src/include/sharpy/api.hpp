@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  C++ API for using sharpy from a C++ main, without going through Python.
+  Provided by libsharpy_api (cmake -DSHARPY_CXX_API=ON).
+
+  Ops get deferred and jit-compiled exactly as from Python: creating arrays
+  and computing with them returns immediately; sync(), to_scalar(), gather()
+  and local() wait for the results. Distribution works the same way as well,
+  all functions are collective unless noted otherwise.
+
+  Internally some objects are still Python objects; if no Python interpreter
+  is running, init() starts an embedded one. Application threads never need
+  to hold the GIL.
+
+  Example:
+    SHARPY::api::init("/path/to/libidtr.so");
+    {
+      auto a = SHARPY::api::full({100, 100}, 1.0, SHARPY::FLOAT64);
+      auto b = a * 2.0 + a;
+      double s = SHARPY::api::to_scalar(SHARPY::api::sum(b));
+    }
+    SHARPY::api::fini();
+*/
+
+#pragma once
+
+#include "p2c_ids.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SHARPY {
+
+class FutureArray;
+
+namespace api {
+
+using shape_t = std::vector<int64_t>;
+
+/// use all processes
+constexpr uint64_t DEFAULT_TEAM = 1;
+/// root argument requesting results on all processes
+constexpr uint64_t ALL_RANKS = static_cast<uint64_t>(-2);
+
+/// DTypeId of C++ type T
+template <typename T> struct dtype_of {};
+template <> struct dtype_of<double> {
+  static constexpr DTypeId value = FLOAT64;
+};
+template <> struct dtype_of<float> {
+  static constexpr DTypeId value = FLOAT32;
+};
+template <> struct dtype_of<int64_t> {
+  static constexpr DTypeId value = INT64;
+};
+template <> struct dtype_of<int32_t> {
+  static constexpr DTypeId value = INT32;
+};
+template <> struct dtype_of<int16_t> {
+  static constexpr DTypeId value = INT16;
+};
+template <> struct dtype_of<int8_t> {
+  static constexpr DTypeId value = INT8;
+};
+template <> struct dtype_of<uint64_t> {
+  static constexpr DTypeId value = UINT64;
+};
+template <> struct dtype_of<uint32_t> {
+  static constexpr DTypeId value = UINT32;
+};
+template <> struct dtype_of<uint16_t> {
+  static constexpr DTypeId value = UINT16;
+};
+template <> struct dtype_of<uint8_t> {
+  static constexpr DTypeId value = UINT8;
+};
+template <> struct dtype_of<bool> {
+  static constexpr DTypeId value = BOOL;
+};
+
+/// A (possibly distributed) array. Copies refer to the same array, the
+/// array gets dropped when the last copy is destroyed.
+class Array {
+public:
+  Array() = default;
+  /// take ownership of f (internal)
+  explicit Array(FutureArray *f);
+
+  /// @return false for default-constructed arrays
+  bool valid() const { return static_cast<bool>(_impl); }
+  DTypeId dtype() const;
+  shape_t shape() const;
+  int ndim() const;
+  const std::string &device() const;
+  uint64_t team() const;
+
+  /// @return the wrapped array (internal)
+  const FutureArray &impl() const;
+
+private:
+  std::shared_ptr<FutureArray> _impl;
+};
+
+/// start the runtime, libidtr is the path to libidtr.so.
+/// In controller/worker mode (cw) only rank 0 returns.
+void init(const std::string &libidtr, bool cw = false);
+/// stop the runtime, arrays must not be used afterwards
+void fini();
+/// wait until all deferred ops are computed
+void sync();
+/// @return rank of calling process (local)
+uint64_t rank();
+/// @return number of processes (local)
+uint64_t nranks();
+
+// creation
+Array full(const shape_t &shape, double val, DTypeId dtype,
+           const std::string &device = "", uint64_t team = DEFAULT_TEAM);
+Array arange(uint64_t start, uint64_t end, uint64_t step, DTypeId dtype,
+             const std::string &device = "", uint64_t team = DEFAULT_TEAM);
+Array linspace(double start, double end, uint64_t num, bool endpoint,
+               DTypeId dtype, const std::string &device = "",
+               uint64_t team = DEFAULT_TEAM);
+
+// computation
+Array ewbin(EWBinOpId op, const Array &a, const Array &b);
+/// scalar b gets converted to a's dtype
+Array ewbin(EWBinOpId op, const Array &a, double b);
+/// scalar a gets converted to b's dtype
+Array ewbin(EWBinOpId op, double a, const Array &b);
+Array ewuny(EWUnyOpId op, const Array &a);
+/// reduce over given dimensions, all if empty
+Array reduce(ReduceOpId op, const Array &a, const shape_t &dims = {});
+Array sum(const Array &a);
+Array reshape(const Array &a, const shape_t &shape);
+Array astype(const Array &a, DTypeId dtype);
+
+inline Array operator+(const Array &a, const Array &b) {
+  return ewbin(ADD, a, b);
+}
+inline Array operator-(const Array &a, const Array &b) {
+  return ewbin(SUBTRACT, a, b);
+}
+inline Array operator*(const Array &a, const Array &b) {
+  return ewbin(MULTIPLY, a, b);
+}
+inline Array operator/(const Array &a, const Array &b) {
+  return ewbin(DIVIDE, a, b);
+}
+inline Array operator+(const Array &a, double b) { return ewbin(ADD, a, b); }
+inline Array operator-(const Array &a, double b) {
+  return ewbin(SUBTRACT, a, b);
+}
+inline Array operator*(const Array &a, double b) {
+  return ewbin(MULTIPLY, a, b);
+}
+inline Array operator/(const Array &a, double b) {
+  return ewbin(DIVIDE, a, b);
+}
+inline Array operator+(double a, const Array &b) { return ewbin(ADD, a, b); }
+inline Array operator-(double a, const Array &b) {
+  return ewbin(SUBTRACT, a, b);
+}
+inline Array operator*(double a, const Array &b) {
+  return ewbin(MULTIPLY, a, b);
+}
+inline Array operator/(double a, const Array &b) {
+  return ewbin(DIVIDE, a, b);
+}
+
+// exchanging data
+
+/// @return the value of 0d array a, available on all processes
+double to_scalar(const Array &a);
+
+/// copy the entire array into the contiguous row-major buffer out, which
+/// must hold a.shape() elements of a.dtype() on process root (or all
+/// processes if root is ALL_RANKS); other processes may pass nullptr
+void gather(const Array &a, void *out, uint64_t root = ALL_RANKS);
+
+/// The part of an array owned by the calling process.
+/// data stays valid as long as the array exists and is not modified.
+struct LocalPart {
+  void *data;
+  shape_t shape;
+  shape_t strides; // in number of elements
+  shape_t offsets; // position of the local part in the global array
+};
+/// wait for a and return its local part
+LocalPart local(const Array &a);
+
+/// Create a distributed array from contiguous local blocks (no copy), see
+/// sharpy.spmd.from_locals. data must stay alive until the array is
+/// dropped, which the array ensures by keeping a reference to it.
+Array from_local(std::shared_ptr<void> data, const shape_t &localShape,
+                 DTypeId dtype);
+template <typename T>
+Array from_local(std::vector<T> data, const shape_t &localShape) {
+  auto owner = std::make_shared<std::vector<T>>(std::move(data));
+  return from_local(std::shared_ptr<void>(owner, owner->data()), localShape,
+                    dtype_of<T>::value);
+}
+
+} // namespace api
+} // namespace SHARPY
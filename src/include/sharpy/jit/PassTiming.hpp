@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Opt-in compile-time profiling.
+
+  With SHARPY_PASS_TIMING=<prefix> ("1" means "sharpy_pass_timing") every
+  compile records the time of each MLIR pass, of LLVM optimization and of
+  code generation, plus the number of ops before and after lowering.
+  Records are aggregated per module (hash of the MLIR module as compiled)
+  and written at fini to <prefix>.<rank>.json.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace llvm {
+class Module;
+} // namespace llvm
+
+namespace mlir {
+class ModuleOp;
+class PassManager;
+} // namespace mlir
+
+namespace SHARPY {
+namespace jit {
+namespace timing {
+
+/// @return true if compile timing is enabled (SHARPY_PASS_TIMING)
+bool enabled();
+
+/// time all passes run by pm
+void instrument(::mlir::PassManager &pm);
+
+/// a compile of module (before lowering) starts
+void begin(::mlir::ModuleOp &module);
+/// the module got lowered to the LLVM dialect
+void lowered(::mlir::ModuleOp &module);
+/// LLVM IR got optimized in ns
+void optimized(const ::llvm::Module &module, uint64_t ns);
+/// the compile finished
+void end();
+
+/// write records of this process, called by fini
+void write(uint64_t rank);
+
+} // namespace timing
+} // namespace jit
+} // namespace SHARPY
@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Symbolizing jit-compiled kernels in perf.
+
+  Kernels are named sharpy_<hash>[_<file>_<line>] (see JIT::compile). With
+  SHARPY_PERF_MAP=1 the functions of every compiled engine are appended to
+  /tmp/perf-<pid>.map, which perf reads to symbolize samples in jitted
+  code. Any other value is the directory to write perf-<pid>.map to.
+
+  This works with any LLVM build. If LLVM was built with LLVM_USE_PERF or
+  LLVM_USE_INTEL_JITEVENTS the ExecutionEngine also emits jitdump files or
+  registers with VTune.
+*/
+
+#pragma once
+
+namespace mlir {
+class ExecutionEngine;
+} // namespace mlir
+
+namespace SHARPY {
+namespace jit {
+namespace perfmap {
+
+/// @return true if writing a perf map is enabled (SHARPY_PERF_MAP)
+bool enabled();
+
+/// add the functions of engine to the perf map
+void add(::mlir::ExecutionEngine &engine);
+
+} // namespace perfmap
+} // namespace jit
+} // namespace SHARPY
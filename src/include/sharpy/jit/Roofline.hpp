@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Opt-in roofline analysis of jit-compiled kernels.
+
+  With SHARPY_ROOFLINE=<prefix> ("1" means "sharpy_roofline") the pass
+  sharpy-count-work is added to the CPU pipeline right after fusion. For
+  every linalg op it statically estimates
+    - flops: arithmetic ops in the payload times the iteration space
+    - bytes: compulsory traffic, e.g. every operand read once and every
+      result written once
+  and emits a call to _idtr_count_work which accumulates the estimates at
+  runtime. Together with the measured time of each kernel this gives
+  achieved GFLOP/s, GB/s and arithmetic intensity, aggregated per kernel
+  (named as in profilers) and written at fini to <prefix>.<rank>.json.
+  Rank 0 also prints the most expensive kernels.
+
+  Kernel time includes communication done inside the kernel (e.g. halo
+  updates). Not available on GPUs.
+*/
+
+#pragma once
+
+#include "sharpy/jit/mlir.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace SHARPY {
+namespace jit {
+namespace roofline {
+
+/// @return true if roofline analysis is enabled (SHARPY_ROOFLINE)
+bool enabled();
+
+/// register the sharpy-count-work pass
+void registerPasses();
+/// add the sharpy-count-work pass to pipeline
+void instrument(std::string &pipeline);
+
+/// func is the kernel with given name
+void label(JittedFunc func, const std::string &name);
+
+/// @return work counted so far, pass to record()
+uint64_t flops();
+uint64_t bytes();
+/// func executed in ns, work was counted from flops0/bytes0
+void record(JittedFunc func, uint64_t ns, uint64_t flops0, uint64_t bytes0);
+
+/// write records of this process, called by fini
+void write(uint64_t rank);
+
+} // namespace roofline
+} // namespace jit
+} // namespace SHARPY
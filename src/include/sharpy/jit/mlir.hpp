@@ -23,6 +23,7 @@
 #include <functional>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -107,6 +108,41 @@ using SetResFunc = std::function<void(
     intptr_t r_offset, const intptr_t *r_sizes, const intptr_t *r_strides,
     std::vector<int64_t> &&l_offs)>;
 using ReadyFunc = std::function<void(id_type guid)>;
+// signature of the compiled entry point (packed arguments)
+using JittedFunc = void (*)(void **);
+
+/// Everything needed to invoke a compiled function again without
+/// re-building/compiling it. Filled by DepManager while a recording is active.
+struct Recording {
+  struct Input {
+    id_type _guid;
+    std::vector<int64_t> _layout; // see layout_of()
+  };
+  struct Result {
+    id_type _guid;
+    int _rank;
+    bool _isDist;
+    bool _deliver; // false if only returned but not delivered
+  };
+  // number of functions compiled and operations executed while recording
+  int _nFuncs = 0;
+  int _nRuns = 0;
+  JittedFunc _func = nullptr;
+  std::unique_ptr<::mlir::ExecutionEngine> _engine;
+  uint64_t _osz = 0;
+  std::vector<Input> _inputs;
+  std::vector<Result> _results;
+};
+
+/// @return all properties of given array which influence the argument types
+/// of a jitted function (memref offsets/sizes/strides, local offsets)
+std::vector<int64_t> layout_of(const NDArray *impl);
+/// append given array as input argument(s) to inputs
+void add_inputs(const NDArray *impl, std::vector<void *> &inputs);
+/// extract one result from output buffer and pass it to cb (if not null)
+/// @return number of intptr_t's consumed
+size_t deliver_result(int rank, bool isDist, const intptr_t *output,
+                      const SetResFunc &cb);
 
 // initialize jit
 void init();
@@ -120,6 +156,13 @@ public:
   // run
   std::vector<intptr_t> run(::mlir::ModuleOp &, const std::string &,
                             std::vector<void *> &, size_t);
+  // compile (or get from cache); if the engine is not cached it is
+  // handed over to the caller through the last argument
+  JittedFunc compile(::mlir::ModuleOp &, const std::string &,
+                     std::unique_ptr<::mlir::ExecutionEngine> &);
+  // invoke a compiled function
+  static std::vector<intptr_t> invoke(JittedFunc, std::vector<void *> &,
+                                      size_t);
 
   int verbose() { return _verbose; };
   ::mlir::MLIRContext &context() { return _context; };
@@ -163,13 +206,27 @@ private:
   ::mlir::ModuleOp _module;
   ::mlir::func::FuncOp _func;  // MLIR function to which ops are added
   std::vector<void *> _inputs; // collecting input args
+  std::vector<Recording::Input> _recInputs;
+  bool _recordable = true;
+  // regions (e.g. loops) which are currently open
+  std::vector<::mlir::Operation *> _regions;
+  // arrays which were computed in a region which ended
+  std::unordered_set<id_type> _scoped;
 
   InOut *findInOut(id_type guid);
   static std::string _fname;
+  static Recording *_recording;
 
 public:
   DepManager(JIT &jit);
+  /// start/stop recording compiled functions (worker thread only)
+  static void setRecording(Recording *rec) { _recording = rec; }
+  static Recording *recording() { return _recording; }
+  /// this manager's function will not be recorded
+  void skipRecording() { _recordable = false; }
   void finalizeAndRun();
+  /// @return number of ops (including nested ones) added to the function
+  uint64_t numOps();
   ::mlir::OpBuilder &getBuilder() { return _builder; }
   ::mlir::ModuleOp &getmodule() { return _module; }
   /// @return the ::mlir::Value representing the array
@@ -188,6 +245,13 @@ public:
   /// signals end of lifetime of given array: does not need to be returned
   void drop(id_type guid);
 
+  /// signals begin of the region of given op (e.g. a loop body),
+  /// the function cannot be finalized before the region ended
+  void beginRegion(::mlir::Operation *op) { _regions.emplace_back(op); }
+  /// signals end of the region of given op: arrays computed inside the region
+  /// are not visible after it
+  void endRegion(::mlir::Operation *op);
+
   /// create return statement and add results to function
   /// this must be called after store_inputs
   /// @return size of output in number of intptr_t's
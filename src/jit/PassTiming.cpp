@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Compile-time profiling (see PassTiming.hpp).
+  Compiles happen in the worker thread only, records are not locked.
+*/
+
+#include "sharpy/jit/PassTiming.hpp"
+#include "sharpy/Trace.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/raw_sha1_ostream.h>
+#include <mlir/IR/BuiltinOps.h>
+#include <mlir/Pass/PassInstrumentation.h>
+#include <mlir/Pass/PassManager.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace SHARPY {
+namespace jit {
+namespace timing {
+
+static const std::string prefix =
+    get_prefix_env("SHARPY_PASS_TIMING", "sharpy_pass_timing");
+
+bool enabled() { return !prefix.empty(); }
+
+struct PassTime {
+  std::string _name;
+  uint64_t _runs = 0;
+  uint64_t _ns = 0;
+};
+
+// all compiles of one module
+struct Record {
+  uint64_t _compiles = 0;
+  uint64_t _opsBefore = 0;
+  uint64_t _opsAfter = 0;
+  uint64_t _llvmInstrs = 0;
+  uint64_t _totalNs = 0;
+  uint64_t _lowerNs = 0;
+  uint64_t _optNs = 0;
+  uint64_t _codegenNs = 0;
+  std::vector<PassTime> _passes; // in order of first execution
+
+  PassTime &pass(::llvm::StringRef name) {
+    auto p = std::find_if(_passes.begin(), _passes.end(),
+                          [name](auto &x) { return x._name == name; });
+    if (p != _passes.end()) {
+      return *p;
+    }
+    _passes.push_back({name.str()});
+    return _passes.back();
+  }
+};
+
+static std::map<std::string, Record> records; // by module hash
+static Record *current = nullptr;
+static uint64_t beginNs = 0, loweredNs = 0, optNs = 0;
+
+static uint64_t numOps(::mlir::ModuleOp &module) {
+  uint64_t n = 0;
+  module->walk([&n](::mlir::Operation *) { ++n; });
+  return n;
+}
+
+struct Instrumentation : public ::mlir::PassInstrumentation {
+  std::vector<uint64_t> _starts; // passes nest through adaptors
+
+  void runBeforePass(::mlir::Pass *, ::mlir::Operation *) override {
+    _starts.emplace_back(trace::now());
+  }
+  void runAfterPass(::mlir::Pass *pass, ::mlir::Operation *) override {
+    auto ns = trace::now() - _starts.back();
+    _starts.pop_back();
+    // adaptors (e.g. func.func(...)) have no argument, their passes count
+    if (current && !pass->getArgument().empty()) {
+      auto &p = current->pass(pass->getArgument());
+      ++p._runs;
+      p._ns += ns;
+    }
+  }
+  void runAfterPassFailed(::mlir::Pass *pass, ::mlir::Operation *op) override {
+    runAfterPass(pass, op);
+  }
+};
+
+void instrument(::mlir::PassManager &pm) {
+  pm.addInstrumentation(std::make_unique<Instrumentation>());
+}
+
+void begin(::mlir::ModuleOp &module) {
+  llvm::raw_sha1_ostream shaOS;
+  module->print(shaOS);
+  auto &r = records[llvm::toHex(shaOS.sha1(), true)];
+  ++r._compiles;
+  r._opsBefore = numOps(module);
+  current = &r;
+  optNs = 0;
+  beginNs = trace::now();
+}
+
+void lowered(::mlir::ModuleOp &module) {
+  loweredNs = trace::now();
+  if (current) {
+    current->_lowerNs += loweredNs - beginNs;
+    current->_opsAfter = numOps(module);
+  }
+}
+
+void optimized(const ::llvm::Module &module, uint64_t ns) {
+  optNs += ns;
+  if (current) {
+    current->_optNs += ns;
+    current->_llvmInstrs = module.getInstructionCount();
+  }
+}
+
+void end() {
+  if (current) {
+    auto now = trace::now();
+    current->_totalNs += now - beginNs;
+    current->_codegenNs += now - loweredNs - optNs;
+    current = nullptr;
+  }
+}
+
+static void writePasses(std::ostream &os, const std::vector<PassTime> &ps) {
+  os << "[";
+  for (size_t i = 0; i < ps.size(); ++i) {
+    os << (i ? ",\n    " : "\n    ") << "{\"name\":\"" << ps[i]._name
+       << "\",\"runs\":" << ps[i]._runs << ",\"ns\":" << ps[i]._ns << "}";
+  }
+  os << "]";
+}
+
+void write(uint64_t rank) {
+  if (!enabled()) {
+    return;
+  }
+  auto fname = prefix + "." + std::to_string(rank) + ".json";
+  std::ofstream os(fname);
+  if (!os) {
+    std::cerr << "sharpy: cannot write pass timing " << fname << std::endl;
+    return;
+  }
+
+  // totals over all modules, most expensive first
+  Record total;
+  for (auto &[hash, r] : records) {
+    for (auto &p : r._passes) {
+      auto &t = total.pass(p._name);
+      t._runs += p._runs;
+      t._ns += p._ns;
+    }
+  }
+  std::sort(total._passes.begin(), total._passes.end(),
+            [](auto &a, auto &b) { return a._ns > b._ns; });
+
+  os << "{\"rank\":" << rank << ",\n\"passes\":";
+  writePasses(os, total._passes);
+  os << ",\n\"modules\":[";
+  bool first = true;
+  for (auto &[hash, r] : records) {
+    os << (first ? "\n" : ",\n") << "  {\"hash\":\"" << hash
+       << "\",\"compiles\":" << r._compiles
+       << ",\"ops_before\":" << r._opsBefore
+       << ",\"ops_after\":" << r._opsAfter
+       << ",\"llvm_instructions\":" << r._llvmInstrs
+       << ",\"total_ns\":" << r._totalNs << ",\"lower_ns\":" << r._lowerNs
+       << ",\"llvm_opt_ns\":" << r._optNs
+       << ",\"codegen_ns\":" << r._codegenNs << ",\n   \"passes\":";
+    writePasses(os, r._passes);
+    os << "}";
+    first = false;
+  }
+  os << "\n]}\n";
+}
+
+} // namespace timing
+} // namespace jit
+} // namespace SHARPY
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  perf map of jit-compiled kernels (see PerfMap.hpp).
+  Engines get compiled in the worker thread only, the map is not locked.
+*/
+
+#include "sharpy/jit/PerfMap.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <mlir/ExecutionEngine/ExecutionEngine.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+namespace SHARPY {
+namespace jit {
+namespace perfmap {
+
+static const std::string dir = get_prefix_env("SHARPY_PERF_MAP", "/tmp");
+
+bool enabled() { return !dir.empty(); }
+
+static ::llvm::raw_fd_ostream *mapFile() {
+  static std::unique_ptr<::llvm::raw_fd_ostream> os;
+  if (!os) {
+    auto fname = dir + "/perf-" + std::to_string(getpid()) + ".map";
+    std::error_code ec;
+    os = std::make_unique<::llvm::raw_fd_ostream>(fname, ec,
+                                                  ::llvm::sys::fs::OF_Append);
+    if (ec) {
+      std::cerr << "sharpy: cannot write perf map " << fname << ": "
+                << ec.message() << std::endl;
+    }
+  }
+  return os->has_error() ? nullptr : os.get();
+}
+
+void add(::mlir::ExecutionEngine &engine) {
+  auto os = mapFile();
+  if (!os) {
+    return;
+  }
+
+  // symbol sizes are only known to the object, the engine keeps a copy
+  ::llvm::SmallString<128> objPath;
+  if (::llvm::sys::fs::createTemporaryFile("sharpy", "o", objPath)) {
+    return;
+  }
+  engine.dumpToObjectFile(objPath);
+  auto obj = ::llvm::object::ObjectFile::createObjectFile(objPath);
+  if (!obj) {
+    ::llvm::consumeError(obj.takeError());
+    ::llvm::sys::fs::remove(objPath);
+    return;
+  }
+
+  for (auto &[sym, size] :
+       ::llvm::object::computeSymbolSizes(*obj->getBinary())) {
+    auto type = sym.getType();
+    auto name = sym.getName();
+    if (!type || !name || *type != ::llvm::object::SymbolRef::ST_Function ||
+        size == 0) {
+      if (!type)
+        ::llvm::consumeError(type.takeError());
+      if (!name)
+        ::llvm::consumeError(name.takeError());
+      continue;
+    }
+    auto addr = engine.lookup(*name);
+    if (!addr) {
+      ::llvm::consumeError(addr.takeError());
+      continue;
+    }
+    *os << ::llvm::format_hex_no_prefix(reinterpret_cast<uintptr_t>(*addr), 1)
+        << " " << ::llvm::format_hex_no_prefix(size, 1) << " " << *name
+        << "\n";
+  }
+  os->flush();
+  ::llvm::sys::fs::remove(objPath);
+}
+
+} // namespace perfmap
+} // namespace jit
+} // namespace SHARPY
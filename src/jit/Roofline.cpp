@@ -0,0 +1,244 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+/*
+  Roofline analysis (see Roofline.hpp).
+  Kernels run in the worker thread only, records are not locked.
+*/
+
+#include "sharpy/jit/Roofline.hpp"
+#include "sharpy/Stats.hpp"
+#include "sharpy/UtilsAndTypes.hpp"
+
+#include <mlir/Dialect/Arith/IR/Arith.h>
+#include <mlir/Dialect/Arith/Utils/Utils.h>
+#include <mlir/Dialect/Func/IR/FuncOps.h>
+#include <mlir/Dialect/Linalg/IR/Linalg.h>
+#include <mlir/Dialect/Linalg/Utils/Utils.h>
+#include <mlir/Dialect/Math/IR/Math.h>
+#include <mlir/IR/BuiltinOps.h>
+#include <mlir/IR/SymbolTable.h>
+#include <mlir/Interfaces/CastInterfaces.h>
+#include <mlir/Pass/Pass.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace SHARPY {
+namespace jit {
+namespace roofline {
+
+static const std::string prefix =
+    get_prefix_env("SHARPY_ROOFLINE", "sharpy_roofline");
+static const char *countFunc = "_idtr_count_work";
+
+bool enabled() { return !prefix.empty(); }
+
+// @return number of arithmetic ops executed per iteration of op
+static uint64_t payloadFlops(::mlir::linalg::LinalgOp op) {
+  uint64_t n = 0;
+  for (auto &pop : op.getBlock()->without_terminator()) {
+    if (::mlir::isa<::mlir::arith::ConstantOp, ::mlir::linalg::IndexOp,
+                    ::mlir::CastOpInterface>(pop)) {
+      continue;
+    }
+    if (::mlir::isa<::mlir::arith::ArithDialect, ::mlir::math::MathDialect>(
+            pop.getDialect())) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+static ::mlir::Value mul(::mlir::OpBuilder &builder, ::mlir::Location loc,
+                         ::mlir::Value a, ::mlir::Value b) {
+  return builder.createOrFold<::mlir::arith::MulIOp>(loc, a, b);
+}
+
+// @return bytes of the tensor/memref val, null if not an array of numbers
+static ::mlir::Value numBytes(::mlir::OpBuilder &builder, ::mlir::Location loc,
+                              ::mlir::Value val) {
+  auto type = ::mlir::dyn_cast<::mlir::ShapedType>(val.getType());
+  if (!type || !type.hasRank() || !type.getElementType().isIntOrFloat()) {
+    return nullptr;
+  }
+  auto elBytes = (type.getElementType().getIntOrFloatBitWidth() + 7) / 8;
+  ::mlir::Value res =
+      builder.create<::mlir::arith::ConstantIndexOp>(loc, elBytes);
+  for (int64_t d = 0; d < type.getRank(); ++d) {
+    res = mul(builder, loc, res,
+              ::mlir::linalg::createOrFoldDimOp(builder, loc, val, d));
+  }
+  return res;
+}
+
+// count work of all linalg ops (on tensors, before bufferization)
+struct CountWorkPass
+    : public ::mlir::PassWrapper<CountWorkPass,
+                                 ::mlir::OperationPass<::mlir::ModuleOp>> {
+  MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(CountWorkPass)
+
+  ::llvm::StringRef getArgument() const final { return "sharpy-count-work"; }
+  ::llvm::StringRef getDescription() const final {
+    return "Count estimated flops and bytes of linalg ops at runtime";
+  }
+  void getDependentDialects(::mlir::DialectRegistry &registry) const override {
+    registry.insert<::mlir::arith::ArithDialect, ::mlir::func::FuncDialect>();
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+    ::mlir::SmallVector<::mlir::linalg::LinalgOp> ops;
+    module->walk([&ops](::mlir::linalg::LinalgOp op) { ops.push_back(op); });
+    if (ops.empty()) {
+      return;
+    }
+
+    ::mlir::OpBuilder builder(module.getBodyRegion());
+    auto i64 = builder.getI64Type();
+    if (!::mlir::SymbolTable::lookupSymbolIn(module, countFunc)) {
+      builder
+          .create<::mlir::func::FuncOp>(
+              module.getLoc(), countFunc,
+              builder.getFunctionType({i64, i64}, {}))
+          .setPrivate();
+    }
+
+    for (auto op : ops) {
+      builder.setInsertionPoint(op);
+      auto loc = op->getLoc();
+
+      ::mlir::Value iters =
+          builder.create<::mlir::arith::ConstantIndexOp>(loc, 1);
+      for (auto &r : op.createLoopRanges(builder, loc)) {
+        iters = mul(builder, loc, iters,
+                    ::mlir::getValueOrCreateConstantIndexOp(builder, loc,
+                                                            r.size));
+      }
+      ::mlir::Value flops = mul(
+          builder, loc, iters,
+          builder.create<::mlir::arith::ConstantIndexOp>(loc,
+                                                         payloadFlops(op)));
+
+      // inputs are read, inits written and read if the payload uses them
+      ::mlir::Value bytes =
+          builder.create<::mlir::arith::ConstantIndexOp>(loc, 0);
+      for (auto &opnd : op->getOpOperands()) {
+        auto n = numBytes(builder, loc, opnd.get());
+        if (!n) {
+          continue;
+        }
+        bytes = builder.createOrFold<::mlir::arith::AddIOp>(loc, bytes, n);
+        if (op.isDpsInit(&opnd) && op.payloadUsesValueFromOperand(&opnd)) {
+          bytes = builder.createOrFold<::mlir::arith::AddIOp>(loc, bytes, n);
+        }
+      }
+
+      builder.create<::mlir::func::CallOp>(
+          loc, countFunc, ::mlir::TypeRange{},
+          ::mlir::ValueRange{
+              builder.create<::mlir::arith::IndexCastOp>(loc, i64, flops),
+              builder.create<::mlir::arith::IndexCastOp>(loc, i64, bytes)});
+    }
+  }
+};
+
+void registerPasses() { ::mlir::PassRegistration<CountWorkPass>(); }
+
+void instrument(std::string &pipeline) {
+  if (useGPU()) {
+    // calls in kernels would prevent outlining them to the GPU
+    std::cerr << "sharpy: SHARPY_ROOFLINE is not supported on GPUs"
+              << std::endl;
+    return;
+  }
+  // count after fusion, fused ops have the loops which actually run
+  static const std::string after = "linalg-fuse-elementwise-ops,";
+  if (auto pos = pipeline.find(after); pos != std::string::npos) {
+    pipeline.insert(pos + after.size(), "sharpy-count-work,");
+  }
+}
+
+// all executions of one kernel
+struct Record {
+  std::string _name;
+  uint64_t _calls = 0;
+  uint64_t _ns = 0;
+  uint64_t _flops = 0;
+  uint64_t _bytes = 0;
+
+  // flops/ns is GFLOP/s and bytes/ns is GB/s
+  double gflops() const { return _ns ? double(_flops) / _ns : 0.; }
+  double gbps() const { return _ns ? double(_bytes) / _ns : 0.; }
+  double intensity() const { return _bytes ? double(_flops) / _bytes : 0.; }
+};
+
+static std::map<JittedFunc, std::string> labels;
+static std::map<std::string, Record> records; // by kernel name
+
+void label(JittedFunc func, const std::string &name) { labels[func] = name; }
+
+uint64_t flops() { return stats::get(stats::EST_FLOPS); }
+uint64_t bytes() { return stats::get(stats::EST_BYTES); }
+
+void record(JittedFunc func, uint64_t ns, uint64_t flops0, uint64_t bytes0) {
+  auto l = labels.find(func);
+  auto &r = records[l == labels.end() ? std::string("unknown") : l->second];
+  ++r._calls;
+  r._ns += ns;
+  // counters might have been reset meanwhile
+  r._flops += std::max(flops(), flops0) - flops0;
+  r._bytes += std::max(bytes(), bytes0) - bytes0;
+}
+
+void write(uint64_t rank) {
+  if (!enabled()) {
+    return;
+  }
+  auto fname = prefix + "." + std::to_string(rank) + ".json";
+  std::ofstream os(fname);
+  if (!os) {
+    std::cerr << "sharpy: cannot write roofline " << fname << std::endl;
+    return;
+  }
+
+  // most expensive first
+  std::vector<Record> kernels;
+  for (auto &[name, r] : records) {
+    kernels.emplace_back(r);
+    kernels.back()._name = name;
+  }
+  std::sort(kernels.begin(), kernels.end(),
+            [](auto &a, auto &b) { return a._ns > b._ns; });
+
+  os << "{\"rank\":" << rank << ",\n\"kernels\":[";
+  for (size_t i = 0; i < kernels.size(); ++i) {
+    auto &k = kernels[i];
+    os << (i ? ",\n" : "\n") << "  {\"kernel\":\"" << k._name
+       << "\",\"calls\":" << k._calls << ",\"ns\":" << k._ns
+       << ",\"flops\":" << k._flops << ",\"bytes\":" << k._bytes
+       << ",\"gflops\":" << k.gflops() << ",\"gbps\":" << k.gbps()
+       << ",\"intensity\":" << k.intensity() << "}";
+  }
+  os << "\n]}\n";
+
+  if (rank == 0 && !kernels.empty()) {
+    std::fprintf(stderr, "sharpy roofline (rank 0, written to %s):\n",
+                 fname.c_str());
+    std::fprintf(stderr, "  %-40s %8s %12s %10s %10s %10s\n", "kernel",
+                 "calls", "time [ms]", "GFLOP/s", "GB/s", "FLOP/B");
+    for (size_t i = 0; i < std::min<size_t>(kernels.size(), 10); ++i) {
+      auto &k = kernels[i];
+      std::fprintf(stderr, "  %-40.40s %8lu %12.3f %10.3f %10.3f %10.3f\n",
+                   k._name.c_str(), static_cast<unsigned long>(k._calls),
+                   k._ns * 1e-6, k.gflops(), k.gbps(), k.intensity());
+    }
+  }
+}
+
+} // namespace roofline
+} // namespace jit
+} // namespace SHARPY
@@ -34,8 +34,14 @@
 */
 
 #include "sharpy/jit/mlir.hpp"
+#include "sharpy/Deferred.hpp"
+#include "sharpy/jit/PassTiming.hpp"
+#include "sharpy/jit/PerfMap.hpp"
+#include "sharpy/jit/Roofline.hpp"
 #include "sharpy/NDArray.hpp"
 #include "sharpy/Registry.hpp"
+#include "sharpy/Stats.hpp"
+#include "sharpy/Trace.hpp"
 #include "sharpy/UtilsAndTypes.hpp"
 
 // #include "llvm/Support/InitLLVM.h"
@@ -89,6 +95,8 @@
 // #include "mlir/Target/LLVMIR/Dialect/OpenMP/OpenMPToLLVMIRTranslation.h"
 #include <mlir/Dialect/LLVMIR/LLVMDialect.h>
 
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/raw_sha1_ostream.h>
 
 #include <imex/Dialect/Dist/Utils/Utils.h>
@@ -194,6 +202,7 @@ static ::mlir::Type getTType(::mlir::OpBuilder &builder, DTypeId dtype,
 }
 
 std::string DepManager::_fname = "sharpy_jit";
+Recording *DepManager::_recording = nullptr;
 
 DepManager::DepManager(jit::JIT &jit) : _jit(jit), _builder(&jit.context()) {
   auto loc = _builder.getUnknownLoc();
@@ -211,7 +220,18 @@ DepManager::DepManager(jit::JIT &jit) : _jit(jit), _builder(&jit.context()) {
   _builder.setInsertionPointToStart(&entryBlock);
 }
 
+uint64_t DepManager::numOps() {
+  uint64_t n = 0;
+  _func->walk([&n](::mlir::Operation *) { ++n; });
+  return n - 1; // the function itself
+}
+
 void DepManager::finalizeAndRun() {
+  if (!_regions.empty()) {
+    throw std::runtime_error(
+        "Cannot execute while generating a loop (loop bodies must not "
+        "synchronize).");
+  }
   // get input buffers (before results!)
   auto input = finalize_inputs();
   // create return statement and adjust function type
@@ -226,7 +246,24 @@ void DepManager::finalizeAndRun() {
 
   if (osz > 0 || !input.empty()) {
     // compile and run the module
-    auto output = _jit.run(_module, _fname, input, osz);
+    std::vector<intptr_t> output;
+    if (auto rec = _recordable ? _recording : nullptr) {
+      // keep what we need to run this function again
+      ++rec->_nFuncs;
+      rec->_func = _jit.compile(_module, _fname, rec->_engine);
+      rec->_osz = osz;
+      rec->_inputs = std::move(_recInputs);
+      rec->_results.clear();
+      for (auto &x : _inOut) {
+        if (x._value) {
+          rec->_results.emplace_back(Recording::Result{
+              x._guid, x._rank, x._isDist, static_cast<bool>(x._setResFunc)});
+        }
+      }
+      output = JIT::invoke(rec->_func, input, osz);
+    } else {
+      output = _jit.run(_module, _fname, input, osz);
+    }
     // we assume we only store memrefdescriptors, e.g. arrays of inptr_t
     for (auto p : input) {
       delete[] reinterpret_cast<intptr_t *>(p);
@@ -254,6 +291,10 @@ DepManager::InOut *DepManager::findInOut(id_type guid) {
 ::mlir::Value DepManager::getDependent(::mlir::OpBuilder &builder,
                                        const array_i::future_type &fut) {
   id_type guid = fut.guid();
+  if (_scoped.count(guid)) {
+    throw std::runtime_error(
+        "array computed in a loop body cannot be used outside the loop");
+  }
   if (auto d = findInOut(guid); !d) {
     // this must be an argument, so the future should be ready
     auto impl = std::dynamic_pointer_cast<NDArray>(fut.get());
@@ -276,6 +317,49 @@ static ::mlir::MemRefType getMRType(size_t ndims, const DynMemRef &mr,
   return getMRType(ndims, mr._offset, mr._sizes, mr._strides, elType);
 }
 
+static intptr_t *storeMR(size_t ndims, const DynMemRef &mr) {
+  intptr_t *buff = new intptr_t[memref_sz(ndims)];
+  buff[0] = reinterpret_cast<intptr_t>(mr._allocated);
+  buff[1] = reinterpret_cast<intptr_t>(mr._aligned);
+  buff[2] = static_cast<intptr_t>(mr._offset);
+  memcpy(buff + 3, mr._sizes, ndims * sizeof(intptr_t));
+  memcpy(buff + 3 + ndims, mr._strides, ndims * sizeof(intptr_t));
+  return buff;
+} // FIXME memory leak?
+
+void add_inputs(const NDArray *impl, std::vector<void *> &inputs) {
+  size_t ndims = impl->ndims();
+  if (impl->team() == 0 || ndims == 0) {
+    inputs.push_back(storeMR(ndims, impl->owned_data()));
+  } else {
+    inputs.push_back(storeMR(ndims, impl->left_halo()));
+    inputs.push_back(storeMR(ndims, impl->owned_data()));
+    inputs.push_back(storeMR(ndims, impl->right_halo()));
+  }
+}
+
+std::vector<int64_t> layout_of(const NDArray *impl) {
+  // everything which goes into the types of the function arguments
+  size_t ndims = impl->ndims();
+  bool isDist = impl->team() != 0 && ndims > 0;
+  std::vector<int64_t> res = {static_cast<int64_t>(ndims), isDist};
+  auto addMR = [&res, ndims](const DynMemRef &mr) {
+    res.emplace_back(mr._offset);
+    for (size_t i = 0; i < ndims; ++i) {
+      res.emplace_back(mr._sizes ? mr._sizes[i] : 0);
+      res.emplace_back(mr._strides ? mr._strides[i] : 0);
+    }
+  };
+  addMR(impl->owned_data());
+  if (isDist) {
+    addMR(impl->left_halo());
+    addMR(impl->right_halo());
+    res.insert(res.end(), impl->local_offsets().begin(),
+               impl->local_offsets().end());
+  }
+  return res;
+}
+
 // add a new array input argument to the jit function
 // the array is passed as memrefs and integers
 // a initializing operation is added at the beginning of the function to form a
@@ -301,21 +385,15 @@ static ::mlir::MemRefType getMRType(size_t ndims, const DynMemRef &mr,
   ::mlir::OpBuilder::InsertionGuard g(_builder);
   _builder.setInsertionPointToStart(&_func.front());
 
-  auto storeMR = [ndims](const DynMemRef &mr) -> intptr_t * {
-    intptr_t *buff = new intptr_t[memref_sz(ndims)];
-    buff[0] = reinterpret_cast<intptr_t>(mr._allocated);
-    buff[1] = reinterpret_cast<intptr_t>(mr._aligned);
-    buff[2] = static_cast<intptr_t>(mr._offset);
-    memcpy(buff + 3, mr._sizes, ndims * sizeof(intptr_t));
-    memcpy(buff + 3 + ndims, mr._strides, ndims * sizeof(intptr_t));
-    return buff;
-  }; // FIXME memory leak?
+  add_inputs(impl, _inputs);
+  if (_recording && _recordable) {
+    _recInputs.emplace_back(Recording::Input{guid, layout_of(impl)});
+  }
 
   if (impl->team() == 0 || ndims == 0) {
     // no-dist-mode is simpler: just the local data memref
     auto typ = getMRType(ndims, impl->owned_data(), elType);
     _func.insertArgument(idx, typ, {}, loc);
-    _inputs.push_back(storeMR(impl->owned_data()));
     auto arTyp =
         getTType(builder, impl->dtype(), impl->device(), impl->shape());
     val = _builder.create<::imex::ndarray::FromMemRefOp>(
@@ -324,15 +402,12 @@ static ::mlir::MemRefType getMRType(size_t ndims, const DynMemRef &mr,
   } else {
     auto typ = getMRType(ndims, impl->left_halo(), elType);
     _func.insertArgument(idx++, typ, {}, loc);
-    _inputs.push_back(storeMR(impl->left_halo()));
 
     typ = getMRType(ndims, impl->owned_data(), elType);
     _func.insertArgument(idx++, typ, {}, loc);
-    _inputs.push_back(storeMR(impl->owned_data()));
 
     typ = getMRType(ndims, impl->right_halo(), elType);
     _func.insertArgument(idx++, typ, {}, loc);
-    _inputs.push_back(storeMR(impl->right_halo()));
 
     auto lhTyp =
         getTType(builder, impl->dtype(), impl->device(), {lhShape, ndims});
@@ -401,6 +476,23 @@ void DepManager::drop(id_type guid) {
   }
 }
 
+void DepManager::endRegion(::mlir::Operation *op) {
+  if (_regions.empty() || _regions.back() != op) {
+    throw std::runtime_error("Internal error: mismatching region");
+  }
+  _regions.pop_back();
+  for (auto &x : _inOut) {
+    if (x._value &&
+        op->isAncestor(x._value.getParentRegion()->getParentOp())) {
+      // neither returned nor delivered
+      x._value = nullptr;
+      x._setResFunc = nullptr;
+      x._readyFuncs.clear();
+      _scoped.insert(x._guid);
+    }
+  }
+}
+
 // Now we have to define the return type as a ValueRange of all arrays which we
 // have created (runnables have put them into DepManager when generating mlir)
 // We also compute the total size of the struct llvm created for this return
@@ -482,8 +574,8 @@ uint64_t DepManager::handleResult(::mlir::OpBuilder &builder) {
   return 2 * sz;
 }
 
-void DepManager::deliver(std::vector<intptr_t> &outputV, uint64_t sz) {
-  auto output = outputV.data();
+size_t deliver_result(int rank, bool isDist, const intptr_t *output,
+                      const SetResFunc &cb) {
   size_t pos = 0;
 
   auto getMR = [](int rank, auto buff, void *&allocated, void *&aligned,
@@ -491,54 +583,61 @@ void DepManager::deliver(std::vector<intptr_t> &outputV, uint64_t sz) {
     allocated = reinterpret_cast<void *>(buff[0]);
     aligned = reinterpret_cast<void *>(buff[1]);
     offset = buff[2];
-    sizes = &buff[3];
-    strides = &buff[3 + rank];
+    sizes = const_cast<intptr_t *>(&buff[3]);
+    strides = const_cast<intptr_t *>(&buff[3 + rank]);
     return memref_sz(rank);
   };
 
+  void *t_allocated[3];
+  void *t_aligned[3];
+  intptr_t t_offset[3];
+  intptr_t *t_sizes[3];
+  intptr_t *t_strides[3];
+
+  if (rank > 0 && isDist) {
+    for (auto t = 0; t < 3; ++t) {
+      pos += getMR(rank, &output[pos], t_allocated[t], t_aligned[t],
+                   t_offset[t], t_sizes[t], t_strides[t]);
+    }
+    // lastly extract local offsets
+    std::vector<int64_t> l_offs;
+    size_t end = pos + rank;
+    for (; pos < end; ++pos) {
+      l_offs.emplace_back(output[pos]);
+    }
+    if (cb) {
+      // call finalization callback
+      cb(rank, t_allocated[0], t_aligned[0], t_offset[0], t_sizes[0],
+         t_strides[0], // lhsHalo
+         t_allocated[1], t_aligned[1], t_offset[1], t_sizes[1],
+         t_strides[1], // lData
+         t_allocated[2], t_aligned[2], t_offset[2], t_sizes[2],
+         t_strides[2],     // rhsHalo
+         std::move(l_offs) // local offset is 1d array of int64_t
+      );
+    }
+  } else { // 0d array or non-dist
+    pos += getMR(rank, &output[pos], t_allocated[1], t_aligned[1], t_offset[1],
+                 t_sizes[1], t_strides[1]);
+    if (cb) {
+      cb(rank, nullptr, nullptr, 0, nullptr,
+         nullptr, // lhsHalo
+         t_allocated[1], t_aligned[1], t_offset[1], t_sizes[1],
+         t_strides[1],                          // lData
+         nullptr, nullptr, 0, nullptr, nullptr, // lhsHalo
+         {});
+    }
+  }
+  return pos;
+}
+
+void DepManager::deliver(std::vector<intptr_t> &outputV, uint64_t sz) {
+  auto output = outputV.data();
+  size_t pos = 0;
+
   for (auto &x : _inOut) {
     if (x._value) {
-      void *t_allocated[3];
-      void *t_aligned[3];
-      intptr_t t_offset[3];
-      intptr_t *t_sizes[3];
-      intptr_t *t_strides[3];
-
-      if (x._rank > 0 && x._isDist) {
-        for (auto t = 0; t < 3; ++t) {
-          pos += getMR(x._rank, &output[pos], t_allocated[t], t_aligned[t],
-                       t_offset[t], t_sizes[t], t_strides[t]);
-        }
-        // lastly extract local offsets
-        std::vector<int64_t> l_offs;
-        size_t end = pos + x._rank;
-        for (; pos < end; ++pos) {
-          l_offs.emplace_back(output[pos]);
-        }
-        if (x._setResFunc) {
-          // call finalization callback
-          x._setResFunc(x._rank, t_allocated[0], t_aligned[0], t_offset[0],
-                        t_sizes[0],
-                        t_strides[0], // lhsHalo
-                        t_allocated[1], t_aligned[1], t_offset[1], t_sizes[1],
-                        t_strides[1], // lData
-                        t_allocated[2], t_aligned[2], t_offset[2], t_sizes[2],
-                        t_strides[2],     // rhsHalo
-                        std::move(l_offs) // local offset is 1d array of int64_t
-          );
-        }
-      } else { // 0d array or non-dist
-        pos += getMR(x._rank, &output[pos], t_allocated[1], t_aligned[1],
-                     t_offset[1], t_sizes[1], t_strides[1]);
-        if (x._setResFunc) {
-          x._setResFunc(x._rank, nullptr, nullptr, 0, nullptr,
-                        nullptr, // lhsHalo
-                        t_allocated[1], t_aligned[1], t_offset[1], t_sizes[1],
-                        t_strides[1],                          // lData
-                        nullptr, nullptr, 0, nullptr, nullptr, // lhsHalo
-                        {});
-        }
-      }
+      pos += deliver_result(x._rank, x._isDist, &output[pos], x._setResFunc);
     }
 
     // not attached to value, call always if provided
@@ -560,14 +659,43 @@ static std::map<std::array<unsigned char, 20>,
 std::vector<intptr_t> JIT::run(::mlir::ModuleOp &module,
                                const std::string &fname,
                                std::vector<void *> &inp, size_t osz) {
+  std::unique_ptr<::mlir::ExecutionEngine> tmpEngine;
+  auto jittedFuncPtr = compile(module, fname, tmpEngine);
+  return invoke(jittedFuncPtr, inp, osz);
+}
 
-  int vtSHARPYClass, vtHashSym, vtEEngineSym, vtRunSym, vtHashGenSym;
+// @return name of the kernel compiled from module: the hash identifies it,
+// the first Python source location (if any) tells where it comes from
+static std::string kernelName(::mlir::ModuleOp &module,
+                              const std::array<unsigned char, 20> &cksm) {
+  auto name =
+      "sharpy_" + llvm::toHex(::llvm::ArrayRef<uint8_t>(cksm.data(), 6), true);
+  ::mlir::FileLineColLoc loc;
+  module->walk([&loc](::mlir::Operation *op) {
+    loc = op->getLoc()->findInstanceOf<::mlir::FileLineColLoc>();
+    return loc ? ::mlir::WalkResult::interrupt()
+               : ::mlir::WalkResult::advance();
+  });
+  if (loc) {
+    name += "_";
+    for (auto c : llvm::sys::path::stem(loc.getFilename().getValue())) {
+      name += llvm::isAlnum(c) ? c : '_';
+    }
+    name += "_" + std::to_string(loc.getLine());
+  }
+  return name;
+}
+
+JittedFunc JIT::compile(::mlir::ModuleOp &module, const std::string &fname,
+                        std::unique_ptr<::mlir::ExecutionEngine> &owned) {
+  TRACE_SCOPE("compile", "jit");
+
+  int vtSHARPYClass, vtHashSym, vtEEngineSym, vtHashGenSym;
   if (HAS_ITAC()) {
     VT(VT_classdef, "sharpy", &vtSHARPYClass);
     VT(VT_funcdef, "lookup_cache", vtSHARPYClass, &vtHashSym);
     VT(VT_funcdef, "gen_sha", vtSHARPYClass, &vtHashGenSym);
     VT(VT_funcdef, "eengine", vtSHARPYClass, &vtEEngineSym);
-    VT(VT_funcdef, "run", vtSHARPYClass, &vtRunSym);
     VT(VT_begin, vtEEngineSym);
 
     ::mlir::OpBuilder builder(module->getContext());
@@ -582,21 +710,31 @@ std::vector<intptr_t> JIT::run(::mlir::ModuleOp &module,
         .setPrivate();
   }
 
-  ::mlir::ExecutionEngine *enginePtr;
-  std::unique_ptr<::mlir::ExecutionEngine> tmpEngine;
+  VT(VT_begin, vtHashGenSym);
+  // locations are part of the key so that debug info is never stale
+  llvm::raw_sha1_ostream shaOS;
+  module->print(shaOS,
+                ::mlir::OpPrintingFlags().enableDebugInfo(use_src_locs()));
+  auto cksm = shaOS.sha1();
+  VT(VT_end, vtHashGenSym);
 
-  if (_useCache) {
-    VT(VT_begin, vtHashGenSym);
+  // all kernels come from a function fname, name them apart for profilers
+  // (after hashing, the name is derived from the hash)
+  auto name = kernelName(module, cksm);
+  module.lookupSymbol<::mlir::func::FuncOp>(fname).setSymName(name);
 
-    llvm::raw_sha1_ostream shaOS;
-    module->print(shaOS);
-    auto cksm = shaOS.sha1();
-    VT(VT_end, vtHashGenSym);
+  ::mlir::ExecutionEngine *enginePtr;
 
+  if (_useCache) {
     VT(VT_begin, vtHashSym);
     if (auto search = engineCache.find(cksm); search == engineCache.end()) {
+      trace::instant("cache_miss", "jit");
+      stats::add(stats::CACHE_MISSES);
       engineCache[cksm] = createExecutionEngine(module);
+      stats::set(stats::CACHED_ENGINES, engineCache.size());
     } else {
+      trace::instant("cache_hit", "jit");
+      stats::add(stats::CACHE_HITS);
       if (_verbose) {
         std::cerr << "cached..." << std::endl;
       }
@@ -605,19 +743,35 @@ std::vector<intptr_t> JIT::run(::mlir::ModuleOp &module,
     VT(VT_end, vtHashSym);
   } else {
     VT(VT_begin, vtHashSym);
-    tmpEngine = createExecutionEngine(module);
-    enginePtr = tmpEngine.get();
+    owned = createExecutionEngine(module);
+    enginePtr = owned.get();
     VT(VT_end, vtHashSym);
   }
 
   auto expectedFPtr =
-      enginePtr->lookupPacked(std::string("_mlir_ciface_") + fname);
+      enginePtr->lookupPacked(std::string("_mlir_ciface_") + name);
   if (auto err = expectedFPtr.takeError()) {
     ::llvm::errs() << "JIT invocation failed: " << toString(std::move(err))
                    << "\n";
     throw std::runtime_error("JIT invocation failed");
   }
-  auto jittedFuncPtr = *expectedFPtr;
+  VT(VT_end, vtEEngineSym);
+  if (roofline::enabled())
+    roofline::label(*expectedFPtr, name);
+  return *expectedFPtr;
+}
+
+std::vector<intptr_t> JIT::invoke(JittedFunc jittedFuncPtr,
+                                  std::vector<void *> &inp, size_t osz) {
+  TRACE_SCOPE("kernel", "jit");
+  auto begin = trace::now();
+  auto flops0 = roofline::flops(), bytes0 = roofline::bytes();
+  int vtSHARPYClass, vtRunSym;
+  if (HAS_ITAC()) {
+    VT(VT_classdef, "sharpy", &vtSHARPYClass);
+    VT(VT_funcdef, "run", vtSHARPYClass, &vtRunSym);
+    VT(VT_begin, vtRunSym);
+  }
 
   // pack function arguments
   llvm::SmallVector<void *> args;
@@ -635,37 +789,76 @@ std::vector<intptr_t> JIT::run(::mlir::ModuleOp &module,
 
   // call function
   (*jittedFuncPtr)(args.data());
+  auto ns = trace::now() - begin;
+  stats::add(stats::KERNELS);
+  stats::add(stats::KERNEL_NS, ns);
+  if (roofline::enabled())
+    roofline::record(jittedFuncPtr, ns, flops0, bytes0);
 
-  VT(VT_end, vtEEngineSym);
+  VT(VT_end, vtRunSym);
   return out;
 }
 
+// print module, including locations if enabled
+static void dump(::mlir::ModuleOp &module) {
+  module->print(llvm::errs(),
+                ::mlir::OpPrintingFlags().enableDebugInfo(use_src_locs()));
+  llvm::errs() << "\n";
+}
+
 std::unique_ptr<::mlir::ExecutionEngine>
 JIT::createExecutionEngine(::mlir::ModuleOp &module) {
   if (_verbose)
     std::cerr << "compiling..." << std::endl;
   if (_verbose > 1)
-    module.dump();
+    dump(module);
 
+  auto begin = trace::now();
+  if (timing::enabled())
+    timing::begin(module);
   // Create an ::mlir execution engine. The execution engine eagerly
   // JIT-compiles the module.
   ::mlir::ExecutionEngineOptions opts;
   opts.transformer = _optPipeline;
+  if (timing::enabled()) {
+    opts.transformer = [this](::llvm::Module *m) {
+      auto t0 = trace::now();
+      auto err = _optPipeline(m);
+      timing::optimized(*m, trace::now() - t0);
+      return err;
+    };
+  }
   opts.jitCodeGenOptLevel = llvm::CodeGenOpt::getLevel(_jit_opt_level);
   opts.sharedLibPaths = _sharedLibPaths;
   opts.enableObjectDump = true;
+  // register with perf (jitdump) or VTune if LLVM was built with support
+  // (LLVM_USE_PERF, LLVM_USE_INTEL_JITEVENTS), and with gdb
+  opts.enablePerfNotificationListener = true;
+  opts.enableGDBNotificationListener = true;
 
   // lower to LLVM
-  if (::mlir::failed(_pm.run(module)))
-    throw std::runtime_error("failed to run pass manager");
+  {
+    TRACE_SCOPE("lower", "jit");
+    if (::mlir::failed(_pm.run(module)))
+      throw std::runtime_error("failed to run pass manager");
+  }
+  if (timing::enabled())
+    timing::lowered(module);
 
   if (_verbose > 2)
-    module.dump();
+    dump(module);
 
+  TRACE_SCOPE("codegen", "jit");
   auto maybeEngine = ::mlir::ExecutionEngine::create(module, opts);
   if (!maybeEngine) {
     throw std::runtime_error("failed to construct an execution engine");
   }
+  stats::add(stats::COMPILES);
+  stats::add(stats::COMPILE_NS, trace::now() - begin);
+  if (timing::enabled())
+    timing::end();
+  if (perfmap::enabled())
+    perfmap::add(*maybeEngine.get());
   return std::move(maybeEngine.get());
 }
 
@@ -811,13 +1004,21 @@ JIT::JIT(const std::string &libidtr)
   _context.getOrLoadDialect<::mlir::linalg::LinalgDialect>();
   _context.getOrLoadDialect<::imex::region::RegionDialect>();
   // create the pass pipeline from string
-  if (::mlir::failed(::mlir::parsePassPipeline(pass_pipeline, _pm)))
+  auto pipeline = pass_pipeline;
+  if (roofline::enabled())
+    roofline::instrument(pipeline);
+  // with Python source locations we also emit debug info for them
+  if (use_src_locs())
+    pipeline += ",ensure-debug-info-scope-on-llvm-func";
+  if (::mlir::failed(::mlir::parsePassPipeline(pipeline, _pm)))
     throw std::runtime_error("failed to parse pass pipeline");
+  if (timing::enabled())
+    timing::instrument(_pm);
 
   _verbose = get_int_env("SHARPY_VERBOSE");
   // some verbosity
   if (_verbose) {
-    std::cerr << "SHARPY_PASSES=\"" << pass_pipeline << "\"" << std::endl;
+    std::cerr << "SHARPY_PASSES=\"" << pipeline << "\"" << std::endl;
     // _pm.enableStatistics();
     if (_verbose > 2)
       _pm.enableTiming();
@@ -895,6 +1096,7 @@ void init() {
 
   ::mlir::registerAllPasses();
   ::imex::registerAllPasses();
+  roofline::registerPasses();
 
   // Initialize LLVM targets.
   // llvm::InitLLVM y(0, nullptr);
@@ -903,6 +1105,9 @@ void init() {
   ::llvm::InitializeNativeTargetAsmParser();
 }
 
-void fini() { engineCache.clear(); }
+void fini() {
+  engineCache.clear();
+  stats::set(stats::CACHED_ENGINES, 0);
+}
 } // namespace jit
 } // namespace SHARPY
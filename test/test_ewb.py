@@ -15,6 +15,13 @@ mpi_idtypes = [  # FIXME
 
 
 class TestEWB:
+    def test_native_operators(self):
+        a = sp.ones((6,), dtype=sp.float32, device=device)
+        b = 2 * a - 1
+        assert type(b) is sp.ndarray
+        assert b._t is b
+        assert numpy.allclose(sp.to_numpy(b), numpy.ones(6))
+
     def test_add0(self):
         for dtyp in mpi_dtypes:
             a = sp.ones((6, 6), dtype=dtyp, device=device)
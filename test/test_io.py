@@ -1,3 +1,7 @@
+import asyncio
+import os
+import tempfile
+
 import numpy as np
 import pytest
 from utils import device
@@ -55,3 +59,85 @@ class TestIO:
             ]
         )
         assert float(c) == v
+
+    def test_to_numpy_async(self):
+        a = sp.arange(0, 110, 1, dtype=sp.float32, device=device)
+        f = sp.to_numpy_async(a)
+        s = sp.sum(a).float_async()
+        # a can be modified before the result is ready
+        a += 1
+        v = np.arange(0, 110, 1, dtype=np.float32)
+        assert np.array_equal(f.result(), v)
+        assert s.result() == float(np.sum(v))
+        assert np.array_equal(sp.to_numpy(a), v + 1)
+
+    def test_to_numpy_async_await(self):
+        a = sp.ones((8, 8), dtype=sp.int64, device=device)
+
+        async def get():
+            return await asyncio.wrap_future(sp.to_numpy_async(a))
+
+        assert np.all(asyncio.run(get()) == 1)
+
+    def test_to_numpy_chunks(self):
+        a = sp.reshape(
+            sp.arange(0, 110, 1, dtype=sp.float32, device=device), [11, 10]
+        )
+        chunks = []
+        sp.to_numpy_chunks(
+            a, lambda s, c: chunks.append((s, c.copy())), 80, root=None
+        )
+        assert [s for s, _ in chunks] == [0, 2, 4, 6, 8, 10]
+        b = np.concatenate([c for _, c in chunks])
+        v = np.reshape(np.arange(0, 110, 1, dtype=np.float32), (11, 10))
+        assert np.array_equal(b, v)
+
+    def test_to_numpy_chunks_file(self, tmp_path):
+        a = sp.arange(0, 110, 1, dtype=sp.int64, device=device)
+        fname = tmp_path / "chunks.raw"
+        with open(fname, "wb") as f:
+            sp.to_numpy_chunks(a[1:100:3], f, 64, root=None)
+        b = np.fromfile(fname, dtype=np.int64)
+        assert np.array_equal(b, np.arange(0, 110, 1, dtype=np.int64)[1:100:3])
+
+    @pytest.mark.skipif(sp._sharpy_cw, reason="Only applicable to SPMD mode")
+    @pytest.mark.parametrize("compress", [False, True])
+    def test_save_load(self, compress):
+        # needs a directory shared by all processes
+        path = os.path.join(tempfile.gettempdir(), f"sharpy_ckpt_{compress}")
+        a = sp.reshape(
+            sp.arange(0, 110, 1, dtype=sp.float32, device=device), [11, 10]
+        )
+        b = sp.arange(0, 37, 1, dtype=sp.int64, device=device)
+        c = sp.full((), 3, dtype=sp.int32, device=device)
+        sp.save(path, {"a": a, "b": b[1:30:2], "c": c}, compress)
+        res = sp.load(path)
+        assert sorted(res.keys()) == ["a", "b", "c"]
+        assert np.array_equal(
+            sp.to_numpy(res["a"]),
+            np.reshape(np.arange(0, 110, 1, dtype=np.float32), (11, 10)),
+        )
+        assert np.array_equal(
+            sp.to_numpy(res["b"]), np.arange(0, 37, 1, dtype=np.int64)[1:30:2]
+        )
+        assert res["c"].dtype == sp.int32
+        assert int(res["c"]) == 3
+
+    @pytest.mark.skipif(sp._sharpy_cw, reason="Only applicable to SPMD mode")
+    @pytest.mark.parametrize("compress", [False, True])
+    def test_save_async(self, compress):
+        path = os.path.join(tempfile.gettempdir(), f"sharpy_async_{compress}")
+        a = sp.reshape(
+            sp.arange(0, 110, 1, dtype=sp.float32, device=device), [11, 10]
+        )
+        h = sp.save_async(path, {"a": a}, compress)
+        # modifying a must not change the checkpoint
+        a[0:11, 0:10] = sp.full((11, 10), 7, dtype=sp.float32, device=device)
+        h.wait()
+        assert h.done()
+        res = sp.load(path)
+        assert np.array_equal(
+            sp.to_numpy(res["a"]),
+            np.reshape(np.arange(0, 110, 1, dtype=np.float32), (11, 10)),
+        )
+        assert np.all(sp.to_numpy(a) == 7)
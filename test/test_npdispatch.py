@@ -0,0 +1,53 @@
+import numpy
+import pytest
+from utils import device
+
+import sharpy as sp
+
+
+class TestNumpyDispatch:
+    def test_ufunc_unary(self):
+        a = sp.full((16, 16), 9, dtype=sp.float32, device=device)
+        b = numpy.sqrt(a)
+        assert isinstance(b, sp.ndarray)
+        assert float(sp.sum(b, [0, 1])) == 16 * 16 * 3
+
+    def test_ufunc_binary(self):
+        a = sp.arange(0, 8, 1, dtype=sp.int64, device=device)
+        b = numpy.add(a, a)
+        c = numpy.subtract(10, a)
+        assert isinstance(b, sp.ndarray)
+        assert numpy.array_equal(sp.to_numpy(b), numpy.arange(0, 16, 2))
+        assert numpy.array_equal(sp.to_numpy(c), 10 - numpy.arange(0, 8))
+
+    def test_ufunc_reduce(self):
+        a = sp.full((4, 8), 2, dtype=sp.int64, device=device)
+        assert int(numpy.add.reduce(a, axis=None)) == 64
+        b = numpy.add.reduce(a)
+        assert numpy.array_equal(sp.to_numpy(b), numpy.full((8,), 8))
+
+    def test_function_sum(self):
+        a = sp.full((4, 8), 2, dtype=sp.int64, device=device)
+        assert isinstance(numpy.sum(a), sp.ndarray)
+        assert int(numpy.sum(a)) == 64
+        b = numpy.sum(a, axis=1)
+        assert numpy.array_equal(sp.to_numpy(b), numpy.full((4,), 16))
+
+    def test_function_reshape(self):
+        a = sp.arange(0, 12, 1, dtype=sp.int64, device=device)
+        b = numpy.reshape(a, (3, 4))
+        assert isinstance(b, sp.ndarray)
+        assert tuple(b.shape) == (3, 4)
+
+    def test_unsupported(self):
+        a = sp.full((4,), 2, dtype=sp.float32, device=device)
+        with pytest.raises(TypeError):
+            numpy.cumsum(a)
+        with pytest.raises(TypeError):
+            numpy.add(a, numpy.ones(4, dtype=numpy.float32))
+
+    def test_implicit_gather_warns(self):
+        a = sp.arange(0, 8, 1, dtype=sp.int64, device=device)
+        with pytest.warns(sp.GatherWarning):
+            b = numpy.asarray(a)
+        assert numpy.array_equal(b, numpy.arange(0, 8))
@@ -48,6 +48,16 @@ class TestSetGet:
 
         assert runAndCompare(doit)
 
+    def test_setitem_numpy(self):
+        def doit(aapi, **kwargs):
+            a = aapi.ones((16, 16), aapi.float32, **kwargs)
+            a[1:13:3, 2:15:2] = numpy.arange(28, dtype=numpy.float64).reshape(
+                (4, 7)
+            )
+            return a
+
+        assert runAndCompare(doit)
+
     def test_setitem4(self):
         # Note: test halo update without send buffer
         def doit(aapi, **kwargs):
@@ -203,3 +213,35 @@ class TestSetGet:
         with pytest.raises(IndexError):
             a = sp.ones(shape, dtype=sp.float64)
             a[slices] = 1.0
+
+    def test_item(self):
+        a = sp.reshape(
+            sp.arange(0, 110, 1, dtype=sp.int64, device=device), [11, 10]
+        )
+        assert a.item(3, 4) == 34
+        assert a.item((10, 9)) == 109
+        assert a.item(-1, 0) == 100
+
+    def test_item_0d(self):
+        a = sp.full((), 7.5, dtype=sp.float64, device=device)
+        assert a.item() == 7.5
+
+    def test_itemset(self):
+        a = sp.zeros((11, 10), dtype=sp.float32, device=device)
+        a.itemset(5, 2, 3.0)
+        a.itemset((-1, -1), 4.0)
+        assert a.item(5, 2) == 3.0
+        assert float(sp.sum(a, [0, 1])) == 7.0
+
+    def test_itemset_invalid(self):
+        a = sp.zeros((4, 4), dtype=sp.int64, device=device)
+        with pytest.raises(ValueError):
+            a.itemset(0, 0, "x")
+        with pytest.raises(ValueError):
+            a.itemset(0, 0, None)
+        assert a.item(0, 0) == 0
+
+    def test_item_out_of_bounds(self):
+        a = sp.zeros((4, 4), dtype=sp.float32, device=device)
+        with pytest.raises(IndexError):
+            a.item(4, 0)
@@ -1,3 +1,6 @@
+import os
+import tempfile
+
 import numpy as np
 import pytest
 from mpi4py import MPI
@@ -39,6 +42,22 @@ class TestSPMD:
         assert float(c) == v
         MPI.COMM_WORLD.barrier()
 
+    def test_get_locals_zero_copy(self):
+        a = sp.ones((32, 32), sp.float32, device=device)
+        la1 = sp.spmd.get_locals(a)[0]
+        la2 = sp.spmd.get_locals(a)[0]
+        assert np.shares_memory(la1, la2)
+        MPI.COMM_WORLD.barrier()
+
+    def test_get_locals_lifetime(self):
+        a = sp.full((32, 32), 3, sp.float32, device=device)
+        la = sp.spmd.get_locals(a)[0]
+        del a
+        sp.sync()
+        # local view keeps the data alive
+        assert la.size == 0 or np.all(la == 3)
+        MPI.COMM_WORLD.barrier()
+
     @pytest.mark.skip(reason="FIXME imex-remove-temporaries")
     def test_get_locals_of_view(self):
         a = sp.ones((32, 32), sp.float32, device=device)
@@ -70,6 +89,29 @@ class TestSPMD:
         assert float(c) == v
         MPI.COMM_WORLD.barrier()
 
+    def test_gather_root(self):
+        a = sp.reshape(
+            sp.arange(0, 110, 1, dtype=sp.float32, device=device), [11, 10]
+        )
+        b = sp.to_numpy(a, root=0)
+        if MPI.COMM_WORLD.rank == 0:
+            v = np.reshape(np.arange(0, 110, 1, dtype=np.float32), (11, 10))
+            assert np.array_equal(b, v)
+        else:
+            assert b is None
+        MPI.COMM_WORLD.barrier()
+
+    def test_to_numpy_chunks_root(self):
+        a = sp.arange(0, 110, 1, dtype=sp.float32, device=device)
+        chunks = []
+        sp.to_numpy_chunks(a, lambda s, c: chunks.append(c.copy()), 40)
+        if MPI.COMM_WORLD.rank == 0:
+            b = np.concatenate(chunks)
+            assert np.array_equal(b, np.arange(0, 110, 1, dtype=np.float32))
+        else:
+            assert len(chunks) == 0
+        MPI.COMM_WORLD.barrier()
+
     def test_gather_0d(self):
         a = sp.full((), 5, dtype=sp.int32, device=device)
         b = sp.spmd.gather(a)
@@ -98,6 +140,32 @@ class TestSPMD:
         assert float(c) == v
         MPI.COMM_WORLD.barrier()
 
+    def test_setitem_root(self):
+        a = sp.zeros((16, 12), sp.int64, device=device)
+        v = np.arange(5 * 6, dtype=np.int64).reshape((5, 6))
+        sp.spmd.setitem(
+            a,
+            (slice(3, 16, 3), slice(1, 12, 2)),
+            v if MPI.COMM_WORLD.rank == 0 else None,
+            root=0,
+        )
+        b = sp.to_numpy(a)
+        c = np.zeros((16, 12), np.int64)
+        c[3:16:3, 1:12:2] = v
+        assert np.array_equal(b, c)
+        MPI.COMM_WORLD.barrier()
+
+    def test_load_npy(self):
+        fname = os.path.join(tempfile.gettempdir(), "sharpy_load.npy")
+        v = np.reshape(np.arange(0, 117, 1, dtype=np.float64), (13, 9))
+        if MPI.COMM_WORLD.rank == 0:
+            np.save(fname, v)
+        MPI.COMM_WORLD.barrier()
+        a = sp.load_npy(fname)
+        assert a.dtype == sp.float64
+        assert np.array_equal(sp.to_numpy(a), v)
+        MPI.COMM_WORLD.barrier()
+
     @pytest.mark.skipif(MPI.COMM_WORLD.size > 1, reason="FIXME multi-proc")
     def test_from_locals(self):
         npa = np.arange(1, 11, 2, dtype=np.int64)
@@ -105,3 +173,91 @@ class TestSPMD:
         x = 4711
         npa[0] = x
         assert int(a[0]) == x
+
+    def test_from_locals_irregular(self):
+        rank = MPI.COMM_WORLD.rank
+        nr = MPI.COMM_WORLD.size
+        off = rank * (rank + 1) // 2
+        npa = np.arange(off, off + rank + 1, dtype=np.float64)
+        npa = np.repeat(npa, 4).reshape(rank + 1, 4)
+        a = sp.spmd.from_locals(npa)
+        n = nr * (nr + 1) // 2
+        assert tuple(a.shape) == (n, 4)
+        expected = np.repeat(np.arange(n, dtype=np.float64), 4).reshape(n, 4)
+        assert np.array_equal(sp.to_numpy(a), expected)
+        MPI.COMM_WORLD.barrier()
+
+    def test_from_locals_many(self):
+        rank = MPI.COMM_WORLD.rank
+        nr = MPI.COMM_WORLD.size
+        npa = np.full((2, 3), rank, dtype=np.int32)
+        npb = np.full((rank % 2,), 7, dtype=np.uint8)
+        a, b = sp.spmd.from_locals([npa, npb])
+        assert tuple(a.shape) == (2 * nr, 3)
+        assert tuple(b.shape) == (nr // 2,)
+        assert b.dtype == sp.uint8
+        expected = np.repeat(np.arange(nr, dtype=np.int32), 6).reshape(-1, 3)
+        assert np.array_equal(sp.to_numpy(a), expected)
+        assert np.all(sp.to_numpy(b) == 7)
+        MPI.COMM_WORLD.barrier()
+
+    @pytest.mark.skipif(MPI.COMM_WORLD.size == 1, reason="multi-proc only")
+    def test_from_locals_mismatch(self):
+        rank = MPI.COMM_WORLD.rank
+        last = rank == MPI.COMM_WORLD.size - 1
+        npa = np.zeros((2, 4 if last else 3), dtype=np.float64)
+        with pytest.raises(ValueError):
+            sp.spmd.from_locals(npa)
+        MPI.COMM_WORLD.barrier()
+
+    def test_jit_irregular(self):
+        rank = MPI.COMM_WORLD.rank
+        nr = MPI.COMM_WORLD.size
+        calls = []
+
+        @sp.jit
+        def double(x):
+            calls.append(1)
+            return x * 2
+
+        def irregular(rows):
+            off = sum(rows[:rank])
+            npa = np.arange(off, off + rows[rank], dtype=np.float64)
+            return sp.spmd.from_locals(npa)
+
+        expected = 2 * np.arange(2 * nr, dtype=np.float64)
+        rows = [2] * nr
+        assert np.array_equal(sp.to_numpy(double(irregular(rows))), expected)
+        # same global shape, only the layouts of ranks 1 and 2 change
+        if nr >= 3:
+            rows[1], rows[2] = 1, 3
+        assert np.array_equal(sp.to_numpy(double(irregular(rows))), expected)
+        # all processes record again or none
+        assert len(calls) == (2 if nr >= 3 else 1)
+        MPI.COMM_WORLD.barrier()
+
+    @pytest.mark.skipif(len(device), reason="n.a. on GPU")
+    def test_to_dlpack(self):
+        a = sp.full((32, 32), 3, sp.float32, device=device)
+        la = sp.spmd.get_locals(a)[0]
+        na = np.from_dlpack(a)
+        assert na.shape == la.shape
+        assert np.shares_memory(na, la)
+        assert na.size == 0 or np.all(na == 3)
+        MPI.COMM_WORLD.barrier()
+
+    def test_from_dlpack(self):
+        rank = MPI.COMM_WORLD.rank
+        nr = MPI.COMM_WORLD.size
+        npa = np.arange(0, 12, dtype=np.uint32).reshape(3, 4) + 12 * rank
+        npa = npa[:, 1:3]
+        a = sp.from_dlpack(npa)
+        assert a.dtype == sp.uint32
+        assert tuple(a.shape) == (3 * nr, 2)
+        expected = np.arange(0, 12 * nr, dtype=np.uint32).reshape(-1, 4)
+        assert np.array_equal(sp.to_numpy(a), expected[:, 1:3])
+        npa[0, 0] = 4711
+        for r in range(nr):
+            assert int(a[3 * r, 0]) == 4711
+        assert int(a[3 * nr - 1, 1]) == 12 * nr - 2
+        MPI.COMM_WORLD.barrier()
@@ -1,3 +1,5 @@
+import glob
+import json
 import os
 import subprocess
 import sys
@@ -27,6 +29,7 @@ sp.fini()"""
 
 
 def run_script(sharpy_script, env=None):
+    """Run the script in a subprocess and return its stderr."""
     if env is None:
         env = {}
     cmd = [sys.executable, str(sharpy_script)]
@@ -37,6 +40,7 @@ def run_script(sharpy_script, env=None):
         cmd, env=fullenv, capture_output=True, check=True, text=True
     )
     assert cp.stdout.strip() == "SUCCESS"
+    return cp.stderr
 
 
 @pytest.mark.parametrize("value", [0, 1, 4])
@@ -157,3 +161,87 @@ def test_imexroot_invalid(sharpy_script, value):
 def test_fallback_invalid(sharpy_script, value):
     with pytest.raises(subprocess.CalledProcessError):
         run_script(sharpy_script, {"SHARPY_FALLBACK": value})
+
+
+@pytest.mark.parametrize("value", [0, 1])
+def test_locations(sharpy_script, value):
+    err = run_script(
+        sharpy_script, {"SHARPY_LOCATIONS": value, "SHARPY_VERBOSE": 2}
+    )
+    # the IR dump carries the script's call sites only if enabled
+    assert ("sharpy_script.py" in err) == bool(value)
+    assert ("loc(" in err) == bool(value)
+
+
+@pytest.mark.parametrize("value", ["dog"])
+def test_locations_invalid(sharpy_script, value):
+    with pytest.raises(subprocess.CalledProcessError):
+        run_script(sharpy_script, {"SHARPY_LOCATIONS": value})
+
+
+def run_prefixed(sharpy_script, var, tmp_path):
+    """Run the script with env variable var set to an output prefix.
+    Return the prefix and the loaded output of process 0."""
+    prefix = tmp_path / var.lower()
+    run_script(sharpy_script, {var: prefix})
+    with open(f"{prefix}.0.json") as f:
+        return prefix, json.load(f)
+
+
+def merge(script, prefix):
+    """Merge the per-process files of prefix with scripts/<script> and
+    return the loaded result."""
+    path = os.path.join(os.path.dirname(__file__), "..", "scripts", script)
+    subprocess.run([sys.executable, path, str(prefix)], check=True)
+    with open(f"{prefix}.json") as f:
+        return json.load(f)
+
+
+def test_trace(sharpy_script, tmp_path):
+    prefix, trace = run_prefixed(sharpy_script, "SHARPY_TRACE", tmp_path)
+    names = {e["name"] for e in trace["traceEvents"]}
+    assert {"defer", "flush", "kernel"} <= names
+
+    merged = merge("merge_traces.py", prefix)
+    assert len(merged["traceEvents"]) == len(trace["traceEvents"])
+
+
+def test_comm_stats(sharpy_script, tmp_path):
+    prefix, comm = run_prefixed(sharpy_script, "SHARPY_COMM_STATS", tmp_path)
+    assert len(comm["sent"]) == comm["nranks"]
+    for c in comm["collectives"]:
+        assert c["calls"] >= 1 and c["site"]
+
+    merged = merge("comm_matrix.py", prefix)
+    assert len(merged["matrix"]) == merged["nranks"]
+
+
+def test_pass_timing(sharpy_script, tmp_path):
+    _, timing = run_prefixed(sharpy_script, "SHARPY_PASS_TIMING", tmp_path)
+    assert timing["modules"]
+    assert {"canonicalize", "finalize-memref-to-llvm"} <= {
+        p["name"] for p in timing["passes"]
+    }
+    for m in timing["modules"]:
+        assert m["compiles"] >= 1
+        assert m["total_ns"] >= m["lower_ns"] + m["llvm_opt_ns"]
+
+
+def test_perf_map(sharpy_script, tmp_path):
+    run_script(
+        sharpy_script, {"SHARPY_PERF_MAP": tmp_path, "SHARPY_LOCATIONS": 1}
+    )
+    (fname,) = glob.glob(str(tmp_path / "perf-*.map"))
+    with open(fname) as f:
+        names = [line.split()[2] for line in f]
+    assert any(n.startswith("sharpy_") for n in names)
+    assert any("sharpy_script" in n for n in names)
+
+
+def test_roofline(sharpy_script, tmp_path):
+    _, roofline = run_prefixed(sharpy_script, "SHARPY_ROOFLINE", tmp_path)
+    assert roofline["kernels"]
+    # the script only fills an array: no flops but bytes
+    assert any(k["bytes"] > 0 for k in roofline["kernels"])
+    for k in roofline["kernels"]:
+        assert k["calls"] >= 1